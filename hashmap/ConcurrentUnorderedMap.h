@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>    // std::max
+#include <bit>          // std::bit_ceil, std::countr_zero
+#include <cstddef>      // size_t
+#include <cstdint>      // uint64_t
+#include <functional>   // std::hash
+#include <memory>       // std::allocator, std::allocator_traits, std::unique_ptr
+#include <mutex>        // std::unique_lock
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+#include <utility>      // std::pair
+#include <vector>
+
+#include "UnorderedMap.h"
+
+/*
+    A hash map that many threads can read and write at once.
+
+    Keys are spread over a power of two number of shards, each an ordinary
+    UnorderedMap guarded by its own reader-writer lock, so threads only wait
+    for each other when they touch the same shard. Lookups take the shard's
+    lock shared, modifications take it exclusively.
+
+    The shard is picked by the high bits of the hash code after a full
+    MurmurHash3 finalizer. The mixing keeps identity hashes (std::hash for
+    integers) from landing in one shard, and keeps the keys of one shard from
+    following a pattern that the shard's own bucket policy would turn into
+    clustered buckets (a plain Fibonacci multiply left half the buckets of a
+    shard unused for sequential integer keys).
+
+    Every operation is atomic with respect to the others on the same key.
+    Callbacks run with the shard locked, so they must be short and must not
+    call back into the map. There are no iterators, since a reference into
+    a shard is only safe while its lock is held.
+
+    Each shard gets its own copy of the allocator through
+    select_on_container_copy_construction (a separate pool for PoolAllocator,
+    which is not thread safe).
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename Alloc = std::allocator<std::pair<const Key, T>>, typename RangePolicy = prime_modulo_policy>
+class ConcurrentUnorderedMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using allocator_type = Alloc;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = size_t;
+    using shard_type = UnorderedMap<Key, T, Hash, Pred, Alloc, RangePolicy>;
+
+    private:
+
+    //one cache line (at least) per shard so two shards' locks never share one
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        shard_type map;
+
+        Shard(size_type bucket_count, const Hash & hash, const key_equal & equal, const Alloc & alloc)
+            : map(bucket_count, hash, equal, alloc) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    unsigned _shard_bits;
+    Hash _hash;
+
+    Shard & _shard(const Key & key) const {
+        //returns the shard owning key
+        if(_shard_bits == 0) {
+            return *_shards[0];
+        }
+        uint64_t code = _hash(key);
+        code ^= code >> 33;
+        code *= 0xFF51AFD7ED558CCDull;
+        code ^= code >> 33;
+        code *= 0xC4CEB9FE1A85EC53ull;
+        code ^= code >> 33;
+        return *_shards[code >> (64 - _shard_bits)];
+    }
+
+    public:
+
+    explicit ConcurrentUnorderedMap(size_type bucket_count = 0, size_type shard_count = 64,
+                                    const Hash & hash = Hash { }, const key_equal & equal = key_equal { },
+                                    const Alloc & alloc = Alloc { })
+        : _hash(hash) {
+        //shard_count is rounded up to a power of two and bucket_count is split evenly
+        shard_count = std::bit_ceil(std::max<size_type>(shard_count, 1));
+        _shard_bits = std::countr_zero(shard_count);
+        _shards.reserve(shard_count);
+        for(size_type i = 0; i < shard_count; i++) {
+            _shards.push_back(std::make_unique<Shard>(
+                bucket_count / shard_count, hash, equal,
+                std::allocator_traits<Alloc>::select_on_container_copy_construction(alloc)));
+        }
+    }
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap &) = delete;
+    ConcurrentUnorderedMap & operator=(const ConcurrentUnorderedMap &) = delete;
+
+    template <typename M>
+    bool insert_or_update(const Key & key, M && value) {
+        //inserts (key, value) or assigns value to key's mapped value
+        //returns true if key was inserted
+        Shard & shard = _shard(key);
+        std::unique_lock guard(shard.lock);
+        return shard.map.insert_or_assign(key, std::forward<M>(value)).second;
+    }
+
+    template <typename M, typename F>
+    bool insert_or_update(const Key & key, M && value, F && update) {
+        //inserts (key, value) if key is missing, otherwise calls update(T &)
+        //on the mapped value already there, both under the shard's lock
+        //returns true if key was inserted
+        Shard & shard = _shard(key);
+        std::unique_lock guard(shard.lock);
+        auto [it, inserted] = shard.map.try_emplace(key, std::forward<M>(value));
+        if(!inserted) {
+            update(it->second);
+        }
+        return inserted;
+    }
+
+    template <typename F>
+    bool find_and_apply(const Key & key, F && apply) const {
+        //calls apply(const T &) on key's mapped value if key is present
+        //readers of the same shard run in parallel
+        //returns whether key was found
+        Shard & shard = _shard(key);
+        std::shared_lock guard(shard.lock);
+        const shard_type & map = shard.map;
+        auto it = map.find(key);
+        if(it == map.cend()) {
+            return false;
+        }
+        apply(it->second);
+        return true;
+    }
+
+    bool contains(const Key & key) const {
+        return find_and_apply(key, [](const T &) {});
+    }
+
+    bool erase(const Key & key) {
+        //returns whether key was removed
+        Shard & shard = _shard(key);
+        std::unique_lock guard(shard.lock);
+        return shard.map.erase(key) != 0;
+    }
+
+    size_type size() const {
+        //the shards are counted one at a time, so with concurrent writers
+        //this is only a snapshot
+        size_type total = 0;
+        for(const std::unique_ptr<Shard> & shard : _shards) {
+            std::shared_lock guard(shard->lock);
+            total += shard->map.size();
+        }
+        return total;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void clear() {
+        for(const std::unique_ptr<Shard> & shard : _shards) {
+            std::unique_lock guard(shard->lock);
+            shard->map.clear();
+        }
+    }
+
+    size_type shard_count() const noexcept {
+        return _shards.size();
+    }
+};
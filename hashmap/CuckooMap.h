@@ -0,0 +1,654 @@
+#pragma once
+
+#include <algorithm>  // std::max, std::min
+#include <bit>        // std::countr_zero, std::popcount
+#include <cmath>      // std::ceil
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint64_t
+#include <cstring>    // std::memcpy
+#include <functional> // std::hash
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <stdexcept>  // std::length_error
+#include <utility>    // std::pair
+#include <vector>
+
+#include "bucket_policies.h"
+
+/*
+    Bucketized cuckoo hash map with the same public surface as UnorderedMap,
+    for lookups that need a hard bound on how much of the table they touch.
+
+    Every key has exactly two candidate buckets of four slots each, picked
+    from its hash code and from a MurmurHash3 mix of it, and is always in
+    one of them. A bucket's hash codes and occupancy sit together in one
+    cache line apart from the values, so a lookup reads at most two of those
+    lines and only touches the value whose full hash code matched: there
+    are never more than 8 slots to check, however full or unlucky the table.
+
+    When both buckets of a new key are full, a breadth first search over
+    the keys in them (and in their other buckets, and so on) finds the
+    shortest chain of moves that ends in a free slot, and the chain is
+    applied back to front so every key stays in one of its two buckets. If
+    no chain of up to _max_visited buckets exists, the table grows to the
+    RangePolicy's next bucket count (the next prime on the doubling ladder
+    by default); hash codes are cached, so growing does not call the hasher.
+
+    Keys with the same hash code always share their two buckets, so at most
+    8 of them fit (4 when the code's two buckets are always the same one,
+    as for a code of 0), and no amount of growing makes room for more.
+    Inserting one more throws std::length_error instead of growing without
+    end, and so does an insert that still finds no chain after the table
+    grew _max_growths times. A hasher with that many collisions belongs in
+    a chained map such as UnorderedMap.
+
+    Like any open addressing table, inserting may move elements
+    (invalidating iterators and references).
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename RangePolicy = prime_reciprocal_policy>
+class CuckooMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using const_mapped_type = const T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using range_policy = RangePolicy;
+
+    static constexpr size_type slots_per_bucket = 4;
+
+    private:
+
+    using slot_allocator = std::allocator<value_type>;
+
+    static constexpr uint8_t _full = (1u << slots_per_bucket) - 1;
+    //buckets the displacement search may look at before the table grows
+    static constexpr size_type _max_visited = 256;
+    //times one insert may grow the table looking for room before it gives up
+    static constexpr unsigned _max_growths = 4;
+
+    //everything a lookup needs before it compares a key, in one cache line
+    struct alignas(64) Bucket {
+        size_t codes[slots_per_bucket];
+        uint8_t used; // bit i is set when slot i holds a value
+    };
+
+    //one node of the displacement search: the value in slot of the parent's
+    //bucket would move into bucket
+    struct Step {
+        size_type bucket;
+        size_type parent;
+        unsigned slot;
+    };
+    static constexpr size_type _root = static_cast<size_type>(-1);
+
+    size_type _bucket_count;
+    RangePolicy _range;
+    Bucket * _buckets;
+    value_type * _slots;
+
+    size_type _size;
+    size_type _max_fill;
+
+    Hash _hash;
+    key_equal _equal;
+
+    float _max_load_factor;
+
+    size_type _slot_count() const {
+        return _bucket_count * slots_per_bucket;
+    }
+
+    bool _used(size_type index) const {
+        return (_buckets[index / slots_per_bucket].used >> (index % slots_per_bucket)) & 1;
+    }
+
+    static size_t _mix(size_t code) {
+        //the MurmurHash3 finalizer, so the second bucket is independent of the
+        //first even for identity hashes
+        uint64_t x = code;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+
+    size_type _first(size_t code) const {
+        return _range.index(code);
+    }
+
+    size_type _second(size_t code) const {
+        return _range.index(_mix(code));
+    }
+
+    size_type _alternate(size_type bucket, size_t code) const {
+        //the other candidate bucket of a key with hash code that sits in bucket
+        size_type first = _first(code);
+        return first == bucket ? _second(code) : first;
+    }
+
+    void _allocate(size_type bucket_count) {
+        //allocates an empty table with bucket_count buckets
+        _bucket_count = bucket_count;
+        _range.reset(bucket_count);
+        _buckets = new Bucket[bucket_count]();
+        _slots = slot_allocator().allocate(_slot_count());
+        _max_fill = static_cast<size_type>(_slot_count() * static_cast<double>(_max_load_factor));
+    }
+
+    void _deallocate() {
+        slot_allocator().deallocate(_slots, _slot_count());
+        delete[] _buckets;
+        _slots = nullptr;
+        _buckets = nullptr;
+    }
+
+    void _destroy_values() {
+        for(size_type i = 0; i < _slot_count(); i++) {
+            if(_used(i)) {
+                _slots[i].~value_type();
+            }
+        }
+    }
+
+    size_type _find_in(size_type bucket, size_t code, const Key & key) const {
+        //returns the slot of bucket holding key, or _slot_count()
+        const Bucket & b = _buckets[bucket];
+        for(unsigned slot = 0; slot < slots_per_bucket; slot++) {
+            if(((b.used >> slot) & 1) && b.codes[slot] == code
+               && _equal(_slots[bucket * slots_per_bucket + slot].first, key)) {
+                return bucket * slots_per_bucket + slot;
+            }
+        }
+        return _slot_count();
+    }
+
+    size_type _find_index(size_t code, const Key & key) const {
+        //returns the slot holding key or _slot_count() if it is not in the map
+        size_type index = _find_in(_first(code), code, key);
+        if(index != _slot_count()) {
+            return index;
+        }
+        return _find_in(_second(code), code, key);
+    }
+
+    void _claim(size_type bucket, unsigned slot, size_t code) {
+        _buckets[bucket].codes[slot] = code;
+        _buckets[bucket].used |= static_cast<uint8_t>(1u << slot);
+    }
+
+    void _move_slot(size_type from, unsigned from_slot, size_type to, unsigned to_slot) {
+        //moves the value in (from, from_slot) into the free (to, to_slot)
+        //the source is destroyed right after, so its key can be moved out from under the const
+        value_type & val = _slots[from * slots_per_bucket + from_slot];
+        new (_slots + to * slots_per_bucket + to_slot)
+            value_type(std::move(const_cast<Key &>(val.first)), std::move(val.second));
+        val.~value_type();
+        _claim(to, to_slot, _buckets[from].codes[from_slot]);
+        _buckets[from].used &= static_cast<uint8_t>(~(1u << from_slot));
+    }
+
+    bool _on_path(const std::vector<Step> & queue, size_type at, size_type bucket) const {
+        //whether bucket is already on the chain leading to queue[at]; a chain
+        //that visits a bucket twice could move a value that is already gone
+        for(; at != _root; at = queue[at].parent) {
+            if(queue[at].bucket == bucket) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool _try_place(size_t code, size_type & placed) {
+        //finds a free slot in one of the two buckets of a new key with hash
+        //code, displacing other keys into their alternate buckets if needed,
+        //and marks it used
+        //returns false without changing anything if no short enough chain of
+        //displacements exists (the caller grows and tries again)
+        size_type first = _first(code);
+        size_type second = _second(code);
+        for(size_type bucket : {first, second}) {
+            if(_buckets[bucket].used != _full) {
+                unsigned slot = std::countr_zero(static_cast<unsigned>(~_buckets[bucket].used));
+                _claim(bucket, slot, code);
+                placed = bucket * slots_per_bucket + slot;
+                return true;
+            }
+        }
+
+        //breadth first, so the chain found is a shortest one
+        std::vector<Step> queue;
+        queue.reserve(_max_visited);
+        queue.push_back({first, _root, 0});
+        if(second != first) {
+            queue.push_back({second, _root, 0});
+        }
+        for(size_type head = 0; head < queue.size(); head++) {
+            const Bucket & bucket = _buckets[queue[head].bucket];
+            if(bucket.used != _full) {
+                //walk the chain back to its root, each move frees the slot
+                //the next one fills
+                unsigned free = std::countr_zero(static_cast<unsigned>(~bucket.used));
+                size_type at = head;
+                while(queue[at].parent != _root) {
+                    const Step & step = queue[at];
+                    _move_slot(queue[step.parent].bucket, step.slot, step.bucket, free);
+                    free = step.slot;
+                    at = step.parent;
+                }
+                _claim(queue[at].bucket, free, code);
+                placed = queue[at].bucket * slots_per_bucket + free;
+                return true;
+            }
+            for(unsigned slot = 0; slot < slots_per_bucket && queue.size() < _max_visited; slot++) {
+                size_type alternate = _alternate(queue[head].bucket, bucket.codes[slot]);
+                if(!_on_path(queue, head, alternate)) {
+                    queue.push_back({alternate, head, slot});
+                }
+            }
+        }
+        return false;
+    }
+
+    size_type _grown_bucket_count() const {
+        return RangePolicy::bucket_count_for(_bucket_count + 1);
+    }
+
+    bool _saturated(size_t code) const {
+        //whether the two buckets of hash code are full of keys with that very
+        //code and would stay so in any table, so growing can never make room
+        size_type first = _first(code);
+        size_type second = _second(code);
+        if(first == second && _mix(code) != code) {
+            //the buckets only coincide at this size
+            return false;
+        }
+        for(size_type bucket : {first, second}) {
+            if(_buckets[bucket].used != _full) {
+                return false;
+            }
+            for(unsigned slot = 0; slot < slots_per_bucket; slot++) {
+                if(_buckets[bucket].codes[slot] != code) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    size_type _prepare_insert(size_t code) {
+        //returns an empty slot, already marked as used, for a new key with hash code
+        //the caller constructs the value there and then counts it in _size, or
+        //hands the slot back with _free_slot if constructing it throws
+        //throws std::length_error, leaving the map as it was apart from its
+        //bucket count, if there is no room for it
+        if(_size + 1 > _max_fill) {
+            _resize(_grown_bucket_count());
+        }
+        size_type index;
+        for(unsigned growths = 0; !_try_place(code, index); growths++) {
+            if(_saturated(code)) {
+                throw std::length_error("too many keys with the same hash code for a CuckooMap");
+            }
+            if(growths == _max_growths) {
+                throw std::length_error("no room for the key in the CuckooMap after growing");
+            }
+            _resize(_grown_bucket_count());
+        }
+        return index;
+    }
+
+    void _resize(size_type bucket_count) {
+        //moves every value into a fresh table with bucket_count buckets,
+        //placing them by their cached hash codes
+        Bucket * old_buckets = _buckets;
+        value_type * old_slots = _slots;
+        size_type old_count = _bucket_count;
+
+        _allocate(bucket_count);
+
+        for(size_type b = 0; b < old_count; b++) {
+            for(unsigned slot = 0; slot < slots_per_bucket; slot++) {
+                if(!((old_buckets[b].used >> slot) & 1)) {
+                    continue;
+                }
+                //running out of room part way just grows the new table again
+                size_type index;
+                while(!_try_place(old_buckets[b].codes[slot], index)) {
+                    _resize(_grown_bucket_count());
+                }
+                value_type & val = old_slots[b * slots_per_bucket + slot];
+                new (_slots + index) value_type(std::move(const_cast<Key &>(val.first)), std::move(val.second));
+                val.~value_type();
+            }
+        }
+
+        slot_allocator().deallocate(old_slots, old_count * slots_per_bucket);
+        delete[] old_buckets;
+    }
+
+    void _free_slot(size_type index) {
+        _buckets[index / slots_per_bucket].used &= static_cast<uint8_t>(~(1u << (index % slots_per_bucket)));
+    }
+
+    void _erase_index(size_type index) {
+        _slots[index].~value_type();
+        _free_slot(index);
+        _size--;
+    }
+
+    template <typename V>
+    std::pair<size_type, bool> _insert_unique(V && value) {
+        //same semantics as UnorderedMap::insert: if the key is already present
+        //its mapped value is overwritten
+        size_t code = _hash(value.first);
+        size_type index = _find_index(code, value.first);
+        if(index != _slot_count()) {
+            if(_slots[index].second != value.second) {
+                _slots[index].second = value.second;
+            }
+            return {index, false};
+        }
+        index = _prepare_insert(code);
+        try {
+            new (_slots + index) value_type(std::forward<V>(value));
+        } catch(...) {
+            _free_slot(index);
+            throw;
+        }
+        _size++;
+        return {index, true};
+    }
+
+    void _copy_from(const CuckooMap & other) {
+        //same layout as other, so every value can go into the same slot
+        _max_load_factor = other._max_load_factor;
+        _allocate(other._bucket_count);
+        std::memcpy(static_cast<void *>(_buckets), other._buckets, _bucket_count * sizeof(Bucket));
+        for(size_type i = 0; i < _slot_count(); i++) {
+            if(_used(i)) {
+                new (_slots + i) value_type(other._slots[i]);
+            }
+        }
+        _size = other._size;
+    }
+
+    void _steal(CuckooMap & other) {
+        _bucket_count = other._bucket_count;
+        _range = other._range;
+        _buckets = other._buckets;
+        _slots = other._slots;
+        _size = other._size;
+        _max_fill = other._max_fill;
+        _max_load_factor = other._max_load_factor;
+
+        other._allocate(RangePolicy::bucket_count_for(1));
+        other._size = 0;
+    }
+
+    public:
+
+    template <typename pointer_type, typename reference_type, typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class CuckooMap<Key, T, Hash, key_equal, RangePolicy>;
+
+        const CuckooMap * _map;
+        size_type _index;
+
+        explicit basic_iterator(CuckooMap const * map, size_type index) noexcept {
+            _map = map;
+            _index = index;
+        }
+
+        void _skip_empty() {
+            while(_index < _map->_slot_count() && !_map->_used(_index)) {
+                _index++;
+            }
+        }
+
+    public:
+        basic_iterator() {
+            _map = nullptr;
+            _index = 0;
+        };
+
+        basic_iterator(const basic_iterator &) = default;
+        basic_iterator(basic_iterator &&) = default;
+        ~basic_iterator() = default;
+        basic_iterator &operator=(const basic_iterator &) = default;
+        basic_iterator &operator=(basic_iterator &&) = default;
+        reference operator*() const {
+            return _map->_slots[_index];
+        }
+        pointer operator->() const {
+            return &(_map->_slots[_index]);
+        }
+        basic_iterator &operator++() {
+            //moves to the next used slot
+            _index++;
+            _skip_empty();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator copy = *this;
+            ++(*this);
+            return copy;
+        }
+        bool operator==(const basic_iterator &other) const noexcept {
+            return _index == other._index;
+        }
+        bool operator!=(const basic_iterator &other) const noexcept {
+            return _index != other._index;
+        }
+    };
+
+    using iterator = basic_iterator<pointer, reference, value_type>;
+    using const_iterator = basic_iterator<const_pointer, const_reference, const value_type>;
+
+    explicit CuckooMap(size_type bucket_count, const Hash & hash = Hash { },
+                       const key_equal & equal = key_equal { }) : _hash(hash), _equal(equal) {
+        //bucket_count (of slots_per_bucket slots each) is rounded up to one
+        //the RangePolicy supports
+        _max_load_factor = 0.9f;
+        _allocate(RangePolicy::bucket_count_for(std::max<size_type>(bucket_count, 1)));
+        _size = 0;
+    }
+
+    ~CuckooMap() {
+        _destroy_values();
+        _deallocate();
+    }
+
+    CuckooMap(const CuckooMap & other) : _hash(other._hash), _equal(other._equal) {
+        _copy_from(other);
+    }
+
+    CuckooMap(CuckooMap && other) : _hash(other._hash), _equal(other._equal) {
+        _steal(other);
+    }
+
+    CuckooMap & operator=(const CuckooMap & other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = other._hash;
+            _equal = other._equal;
+            _copy_from(other);
+        }
+        return *this;
+    }
+
+    CuckooMap & operator=(CuckooMap && other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = std::move(other._hash);
+            _equal = std::move(other._equal);
+            _steal(other);
+        }
+        return *this;
+    }
+
+    void clear() noexcept {
+        _destroy_values();
+        for(size_type b = 0; b < _bucket_count; b++)
+            _buckets[b].used = 0;
+        _size = 0;
+    }
+
+    size_type size() const noexcept {
+        return _size;
+    }
+
+    bool empty() const noexcept {
+        return _size == 0;
+    }
+
+    iterator begin() {
+        iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    iterator end() {
+        return iterator(this, _slot_count());
+    }
+
+    const_iterator cbegin() const {
+        const_iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    const_iterator cend() const {
+        return const_iterator(this, _slot_count());
+    }
+
+    //bucket statistics: a bucket holds up to slots_per_bucket elements
+
+    size_type bucket_count() const noexcept {
+        return _bucket_count;
+    }
+
+    size_type bucket_size(size_type n) const {
+        return std::popcount(static_cast<unsigned>(_buckets[n].used));
+    }
+
+    size_type bucket(const Key & key) const {
+        //returns the first candidate bucket of key (it may sit in the second)
+        return _first(_hash(key));
+    }
+
+    size_type probe_length(const Key & key) const {
+        //number of buckets a lookup for key looks at: 1 or 2 (0 if it is not in the map)
+        size_t code = _hash(key);
+        size_type index = _find_index(code, key);
+        if(index == _slot_count()) {
+            return 0;
+        }
+        return index / slots_per_bucket == _first(code) ? 1 : 2;
+    }
+
+    float load_factor() const {
+        //elements per slot, not per bucket
+        return _size / static_cast<float>(_slot_count());
+    }
+
+    float max_load_factor() const noexcept {
+        return _max_load_factor;
+    }
+
+    void max_load_factor(float ml) {
+        //sets the load factor we are allowed to reach before growing
+        //and grows right away if we are already past it; past about 0.95 the
+        //displacement search starts failing and grows the table anyway
+        _max_load_factor = std::min(ml, 1.0f);
+        _max_fill = static_cast<size_type>(_slot_count() * static_cast<double>(_max_load_factor));
+        if(_size > _max_fill) {
+            reserve(_size);
+        }
+    }
+
+    void rehash(size_type count) {
+        //rebuilds the table with at least count buckets (and enough for our elements)
+        size_type needed = static_cast<size_type>(
+            std::ceil(_size / static_cast<double>(_max_load_factor) / slots_per_bucket));
+        _resize(RangePolicy::bucket_count_for(std::max<size_type>({count, needed, 1})));
+    }
+
+    void reserve(size_type count) {
+        //makes room for count elements without growing again (unless the
+        //displacement search fails)
+        size_type needed = static_cast<size_type>(
+            std::ceil(count / static_cast<double>(_max_load_factor) / slots_per_bucket));
+        if(RangePolicy::bucket_count_for(std::max<size_type>(needed, 1)) > _bucket_count) {
+            _resize(RangePolicy::bucket_count_for(needed));
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        std::pair<size_type, bool> inserted = _insert_unique(std::move(value));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value) {
+        std::pair<size_type, bool> inserted = _insert_unique(value);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    iterator find(const Key & key) {
+        return iterator(this, _find_index(_hash(key), key));
+    }
+
+    T& operator[](const Key & key) {
+        size_t code = _hash(key);
+        size_type index = _find_index(code, key);
+        if(index == _slot_count()) {
+            index = _prepare_insert(code);
+            try {
+                new (_slots + index) value_type(key, T{});
+            } catch(...) {
+                _free_slot(index);
+                throw;
+            }
+            _size++;
+        }
+        return _slots[index].second;
+    }
+
+    iterator erase(iterator pos) {
+        //removes the element at pos and returns an iterator to the element after it
+        if(pos._index == _slot_count()) {
+            return pos;
+        }
+        _erase_index(pos._index);
+        ++pos;
+        return pos;
+    }
+
+    size_type erase(const Key & key) {
+        size_type index = _find_index(_hash(key), key);
+        if(index == _slot_count()) {
+            return 0;
+        }
+        _erase_index(index);
+        return 1;
+    }
+};
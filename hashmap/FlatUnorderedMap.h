@@ -0,0 +1,559 @@
+#pragma once
+
+#include <algorithm>  // std::max
+#include <bit>        // std::countr_zero, std::bit_ceil
+#include <cstddef>    // size_t
+#include <cstdint>    // int8_t, uint32_t
+#include <cstring>    // std::memset
+#include <functional> // std::hash
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <utility>    // std::pair
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    Open addressing hash map with the same public surface as UnorderedMap.
+
+    Every slot has a one byte control word next to it in a separate array:
+    empty, deleted, or the low 7 bits of the hash (H2) of the key stored there.
+    Slots are grouped 16 at a time and a lookup compares all 16 control bytes
+    of a group against H2 at once (one SSE2 compare + movemask, a scalar loop
+    without SSE2), only touching the keys whose control byte matched.
+    Groups are probed quadratically starting from the group picked by the
+    remaining hash bits, and a lookup stops at the first group with an empty slot.
+
+    Values are stored inline in one array, so there is no per element
+    allocation and no pointer chasing. Like any open addressing table,
+    inserting may move elements (invalidating iterators and references)
+    when the table grows.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class FlatUnorderedMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using const_mapped_type = const T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    using ctrl_t = int8_t;
+
+    //control bytes for slots that do not hold a value, both have the high bit set
+    //so "not full" is a single sign test, full slots hold H2 in 0..127
+    static constexpr ctrl_t _empty = -128;   // 0b10000000
+    static constexpr ctrl_t _deleted = -2;   // 0b11111110
+
+    static constexpr size_type _group_width = 16;
+
+    struct Group {
+        //16 control bytes looked at together
+        //every match function returns a bitmask with bit i set if slot i matches
+
+#if defined(__SSE2__)
+        __m128i ctrl;
+
+        explicit Group(const ctrl_t * pos) {
+            ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+        }
+        uint32_t match(ctrl_t h2) const {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+        }
+        uint32_t match_empty() const {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(_empty), ctrl));
+        }
+        uint32_t match_empty_or_deleted() const {
+            //empty and deleted are the only control bytes with the sign bit set
+            return _mm_movemask_epi8(ctrl);
+        }
+#else
+        const ctrl_t * ctrl;
+
+        explicit Group(const ctrl_t * pos) : ctrl(pos) {}
+        uint32_t match(ctrl_t h2) const {
+            uint32_t mask = 0;
+            for(size_type i = 0; i < _group_width; i++)
+                mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+            return mask;
+        }
+        uint32_t match_empty() const {
+            return match(_empty);
+        }
+        uint32_t match_empty_or_deleted() const {
+            uint32_t mask = 0;
+            for(size_type i = 0; i < _group_width; i++)
+                mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+            return mask;
+        }
+#endif
+    };
+
+    //slots are raw storage, a value only exists where the control byte is full
+    using slot_allocator = std::allocator<value_type>;
+
+    size_type _capacity;     // number of slots, a power of two multiple of _group_width
+    size_type _group_shift;  // 64 - log2(number of groups), picks the first group from H1
+    ctrl_t * _ctrl;
+    value_type * _slots;
+
+    size_type _size;
+    size_type _growth_left;  // how many empty slots we may still fill before growing
+
+    Hash _hash;
+    key_equal _equal;
+
+    static ctrl_t _h2(size_t code) {
+        //the low 7 bits go into the control byte
+        return static_cast<ctrl_t>(code & 0x7F);
+    }
+
+    size_type _first_group(size_t code) const {
+        //the group a probe starts at, taken from the high bits of a Fibonacci
+        //multiply so weak hashes (e.g. identity for integers) still spread out
+        if(_capacity == _group_width) {
+            return 0;
+        }
+        return static_cast<size_type>((static_cast<uint64_t>(code) * 0x9E3779B97F4A7C15ull) >> _group_shift);
+    }
+
+    size_type _group_mask() const {
+        return _capacity / _group_width - 1;
+    }
+
+    static size_type _capacity_for(size_type count) {
+        //smallest capacity that holds count elements below the 7/8 max load factor
+        size_type slots = count + count / 7 + 1;
+        return std::bit_ceil(std::max(slots, _group_width));
+    }
+
+    static size_type _max_fill(size_type capacity) {
+        return capacity - capacity / 8;
+    }
+
+    bool _is_full(size_type index) const {
+        return _ctrl[index] >= 0;
+    }
+
+    void _allocate(size_type capacity) {
+        //allocates an all-empty table of capacity slots
+        _capacity = capacity;
+        _group_shift = 64 - std::countr_zero(capacity / _group_width);
+        _ctrl = new ctrl_t[capacity];
+        std::memset(_ctrl, _empty, capacity);
+        _slots = slot_allocator().allocate(capacity);
+        _growth_left = _max_fill(capacity);
+    }
+
+    void _deallocate() {
+        slot_allocator().deallocate(_slots, _capacity);
+        delete[] _ctrl;
+        _slots = nullptr;
+        _ctrl = nullptr;
+    }
+
+    void _destroy_values() {
+        for(size_type i = 0; i < _capacity; i++) {
+            if(_is_full(i)) {
+                _slots[i].~value_type();
+            }
+        }
+    }
+
+    template <typename K>
+    std::pair<size_type, size_type> _probe(size_t code, const K & key) const {
+        //walks the probe sequence for code and returns the slot holding key
+        //(or _capacity if the key is not in the map) and how many groups we looked at
+        ctrl_t h2 = _h2(code);
+        size_type mask = _group_mask();
+        size_type group = _first_group(code);
+
+        for(size_type step = 1; ; step++) {
+            Group g(_ctrl + group * _group_width);
+            for(uint32_t match = g.match(h2); match; match &= match - 1) {
+                size_type index = group * _group_width + std::countr_zero(match);
+                if(_equal(_slots[index].first, key)) {
+                    return {index, step};
+                }
+            }
+            //a group with an empty slot ends every probe sequence that reaches it
+            if(g.match_empty()) {
+                return {_capacity, step};
+            }
+            //triangular steps visit every group when the group count is a power of two
+            group = (group + step) & mask;
+        }
+    }
+
+    template <typename K>
+    size_type _find_index(size_t code, const K & key) const {
+        return _probe(code, key).first;
+    }
+
+    size_type _find_free(size_t code) const {
+        //returns the first empty or deleted slot along the probe sequence for code
+        size_type mask = _group_mask();
+        size_type group = _first_group(code);
+
+        for(size_type step = 1; ; step++) {
+            uint32_t free = Group(_ctrl + group * _group_width).match_empty_or_deleted();
+            if(free) {
+                return group * _group_width + std::countr_zero(free);
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    void _resize(size_type capacity) {
+        //moves every value into a fresh table of capacity slots
+        //deleted slots are dropped along the way
+        ctrl_t * old_ctrl = _ctrl;
+        value_type * old_slots = _slots;
+        size_type old_capacity = _capacity;
+
+        _allocate(capacity);
+
+        for(size_type i = 0; i < old_capacity; i++) {
+            if(old_ctrl[i] < 0) {
+                continue;
+            }
+            value_type & val = old_slots[i];
+            size_t code = _hash(val.first);
+            size_type index = _find_free(code);
+            _ctrl[index] = _h2(code);
+            //the slot is going away, so its key can be moved out from under the const
+            new (_slots + index) value_type(std::move(const_cast<Key &>(val.first)), std::move(val.second));
+            val.~value_type();
+        }
+        _growth_left -= _size;
+
+        slot_allocator().deallocate(old_slots, old_capacity);
+        delete[] old_ctrl;
+    }
+
+    size_type _prepare_insert(size_t code) {
+        //returns the slot a new key with hash code should go into
+        //growing first if we have run out of empty slots
+        //the slot stays free until _commit_insert, so if constructing the value
+        //in it throws the table is left as it was
+        size_type index = _find_free(code);
+        if(_growth_left == 0 && _ctrl[index] == _empty) {
+            //if most of the used-up room is tombstones a same size rehash is enough
+            size_type capacity = _size * 2 < _max_fill(_capacity) ? _capacity : _capacity * 2;
+            _resize(capacity);
+            index = _find_free(code);
+        }
+        return index;
+    }
+
+    void _commit_insert(size_type index, size_t code) {
+        //marks slot index, where a value for hash code was just constructed, as full
+        if(_ctrl[index] == _empty) {
+            _growth_left--;
+        }
+        _ctrl[index] = _h2(code);
+        _size++;
+    }
+
+    void _erase_index(size_type index) {
+        //destroys the value in slot index
+        //a slot can go straight back to empty if its group still has an empty slot,
+        //since then no probe sequence can have passed through the group
+        _slots[index].~value_type();
+        _size--;
+
+        size_type group = index / _group_width;
+        if(Group(_ctrl + group * _group_width).match_empty()) {
+            _ctrl[index] = _empty;
+            _growth_left++;
+        } else {
+            _ctrl[index] = _deleted;
+        }
+    }
+
+    template <typename V>
+    std::pair<size_type, bool> _insert_unique(V && value) {
+        //same semantics as UnorderedMap::insert: if the key is already present
+        //its mapped value is overwritten
+        size_t code = _hash(value.first);
+        size_type index = _find_index(code, value.first);
+        if(index != _capacity) {
+            if(_slots[index].second != value.second) {
+                _slots[index].second = value.second;
+            }
+            return {index, false};
+        }
+        index = _prepare_insert(code);
+        new (_slots + index) value_type(std::forward<V>(value));
+        _commit_insert(index, code);
+        return {index, true};
+    }
+
+    void _copy_from(const FlatUnorderedMap & other) {
+        //same layout as other, so every value can go into the same slot
+        _allocate(other._capacity);
+        std::memcpy(_ctrl, other._ctrl, _capacity);
+        for(size_type i = 0; i < _capacity; i++) {
+            if(other._is_full(i)) {
+                new (_slots + i) value_type(other._slots[i]);
+            }
+        }
+        _size = other._size;
+        _growth_left = other._growth_left;
+    }
+
+    void _steal(FlatUnorderedMap & other) {
+        _capacity = other._capacity;
+        _group_shift = other._group_shift;
+        _ctrl = other._ctrl;
+        _slots = other._slots;
+        _size = other._size;
+        _growth_left = other._growth_left;
+
+        other._allocate(_group_width);
+        other._size = 0;
+    }
+
+    public:
+
+    template <typename pointer_type, typename reference_type, typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class FlatUnorderedMap<Key, T, Hash, key_equal>;
+
+        const FlatUnorderedMap * _map;
+        size_type _index;
+
+        explicit basic_iterator(FlatUnorderedMap const * map, size_type index) noexcept {
+            _map = map;
+            _index = index;
+        }
+
+        void _skip_empty() {
+            while(_index < _map->_capacity && !_map->_is_full(_index)) {
+                _index++;
+            }
+        }
+
+    public:
+        basic_iterator() {
+            _map = nullptr;
+            _index = 0;
+        };
+
+        basic_iterator(const basic_iterator &) = default;
+        basic_iterator(basic_iterator &&) = default;
+        ~basic_iterator() = default;
+        basic_iterator &operator=(const basic_iterator &) = default;
+        basic_iterator &operator=(basic_iterator &&) = default;
+        reference operator*() const {
+            return _map->_slots[_index];
+        }
+        pointer operator->() const {
+            return &(_map->_slots[_index]);
+        }
+        basic_iterator &operator++() {
+            //moves to the next full slot
+            _index++;
+            _skip_empty();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator copy = *this;
+            ++(*this);
+            return copy;
+        }
+        bool operator==(const basic_iterator &other) const noexcept {
+            return _index == other._index;
+        }
+        bool operator!=(const basic_iterator &other) const noexcept {
+            return _index != other._index;
+        }
+    };
+
+    using iterator = basic_iterator<pointer, reference, value_type>;
+    using const_iterator = basic_iterator<const_pointer, const_reference, const value_type>;
+
+    explicit FlatUnorderedMap(size_type bucket_count, const Hash & hash = Hash { },
+                const key_equal & equal = key_equal { }) : _hash(hash), _equal(equal) {
+        //bucket_count is rounded up to a power of two number of 16 slot groups
+        _allocate(std::bit_ceil(std::max(bucket_count, _group_width)));
+        _size = 0;
+    }
+
+    ~FlatUnorderedMap() {
+        _destroy_values();
+        _deallocate();
+    }
+
+    FlatUnorderedMap(const FlatUnorderedMap & other) : _hash(other._hash), _equal(other._equal) {
+        _copy_from(other);
+    }
+
+    FlatUnorderedMap(FlatUnorderedMap && other) : _hash(other._hash), _equal(other._equal) {
+        _steal(other);
+    }
+
+    FlatUnorderedMap & operator=(const FlatUnorderedMap & other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = other._hash;
+            _equal = other._equal;
+            _copy_from(other);
+        }
+        return *this;
+    }
+
+    FlatUnorderedMap & operator=(FlatUnorderedMap && other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = std::move(other._hash);
+            _equal = std::move(other._equal);
+            _steal(other);
+        }
+        return *this;
+    }
+
+    void clear() noexcept {
+        _destroy_values();
+        std::memset(_ctrl, _empty, _capacity);
+        _size = 0;
+        _growth_left = _max_fill(_capacity);
+    }
+
+    size_type size() const noexcept {
+        return _size;
+    }
+
+    bool empty() const noexcept {
+        return _size == 0;
+    }
+
+    iterator begin() {
+        iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    iterator end() {
+        return iterator(this, _capacity);
+    }
+
+    const_iterator cbegin() const {
+        const_iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    const_iterator cend() const {
+        return const_iterator(this, _capacity);
+    }
+
+    //bucket statistics: every slot is a bucket holding at most one element
+
+    size_type bucket_count() const noexcept {
+        return _capacity;
+    }
+
+    size_type bucket_size(size_type n) const {
+        return _is_full(n) ? 1 : 0;
+    }
+
+    size_type bucket(const Key & key) const {
+        //returns the slot holding key, or the first slot of its home group
+        //if the key is not in the map
+        size_t code = _hash(key);
+        size_type index = _find_index(code, key);
+        return index != _capacity ? index : _first_group(code) * _group_width;
+    }
+
+    size_type probe_length(const Key & key) const {
+        //number of groups a lookup for key has to look at
+        return _probe(_hash(key), key).second;
+    }
+
+    float load_factor() const {
+        return _size / static_cast<float>(_capacity);
+    }
+
+    float max_load_factor() const noexcept {
+        //fixed at 7/8, high load factors are what the group compares are for
+        return 0.875f;
+    }
+
+    void rehash(size_type count) {
+        //rebuilds the table with at least count slots (and enough for our elements)
+        size_type capacity = std::max(std::bit_ceil(std::max(count, _group_width)), _capacity_for(_size));
+        _resize(capacity);
+    }
+
+    void reserve(size_type count) {
+        //makes room for count elements without growing again
+        if(_capacity_for(count) > _capacity) {
+            _resize(_capacity_for(count));
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        std::pair<size_type, bool> inserted = _insert_unique(std::move(value));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value) {
+        std::pair<size_type, bool> inserted = _insert_unique(value);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    iterator find(const Key & key) {
+        return iterator(this, _find_index(_hash(key), key));
+    }
+
+    T& operator[](const Key & key) {
+        size_t code = _hash(key);
+        size_type index = _find_index(code, key);
+        if(index == _capacity) {
+            index = _prepare_insert(code);
+            new (_slots + index) value_type(key, T{});
+            _commit_insert(index, code);
+        }
+        return _slots[index].second;
+    }
+
+    iterator erase(iterator pos) {
+        //removes the element at pos and returns an iterator to the element after it
+        //erasing never moves other elements
+        if(pos._index == _capacity) {
+            return pos;
+        }
+        _erase_index(pos._index);
+        ++pos;
+        return pos;
+    }
+
+    size_type erase(const Key & key) {
+        size_type index = _find_index(_hash(key), key);
+        if(index == _capacity) {
+            return 0;
+        }
+        _erase_index(index);
+        return 1;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <bit>        // std::bit_ceil, std::countr_zero
+#include <cstddef>    // size_t
+#include <cstdint>    // uint64_t
+#include <functional> // std::equal_to
+#include <stdexcept>  // std::out_of_range, std::invalid_argument
+#include <utility>    // std::pair
+
+#include "hash_functions.h"
+
+/*
+    A fixed map whose table can be built at compile time.
+
+        constexpr auto commands = make_frozen_map<std::string_view, int>({
+            { "get", 1 }, { "set", 2 }, { "del", 3 },
+        });
+        static_assert(commands.at("set") == 2);
+
+    The N elements are kept in the order given, next to an open addressing
+    index of at least 2N slots (a power of two) that holds element numbers,
+    so a lookup is a hash, a multiply and shift, and a short linear probe
+    over small integers. Everything is constexpr, a lookup of a constant key
+    folds to its value, and a map built in a constexpr variable costs
+    nothing at startup.
+
+    Hash must be constexpr to build at compile time, which is why the default
+    is fnv1a_hash (std::hash is not) together with the transparent
+    std::equal_to<>, so std::string_view keys can be looked up with strings
+    and literals alike. A duplicate key throws std::invalid_argument, which
+    at compile time is a compile error.
+*/
+template <typename Key, typename T, size_t N, typename Hash = fnv1a_hash, typename Pred = std::equal_to<>>
+class FrozenMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<Key, T>;
+    using size_type = size_t;
+    using const_iterator = const value_type *;
+
+    private:
+
+    static constexpr size_type _capacity = std::bit_ceil(2 * N > 1 ? 2 * N : 2);
+    static constexpr unsigned _shift = 64 - std::countr_zero(_capacity);
+    //marks an empty index slot
+    static constexpr size_type _empty = N;
+
+    std::array<value_type, N> _values;
+    std::array<size_type, _capacity> _index;
+
+    Hash _hash;
+    key_equal _equal;
+
+    constexpr size_type _home(size_t code) const {
+        //the top bits of a Fibonacci multiply, so the low quality low bits of
+        //a simple string hash don't decide the slot
+        return static_cast<size_type>((static_cast<uint64_t>(code) * 0x9E3779B97F4A7C15ull) >> _shift);
+    }
+
+    template <typename K>
+    constexpr size_type _find_index(const K & key) const {
+        //returns the element number of key, or N if key is not in the map
+        for(size_type slot = _home(_hash(key)); _index[slot] != _empty; slot = (slot + 1) & (_capacity - 1)) {
+            if(_equal(_values[_index[slot]].first, key)) {
+                return _index[slot];
+            }
+        }
+        return N;
+    }
+
+    public:
+
+    constexpr explicit FrozenMap(const std::array<value_type, N> & values, const Hash & hash = Hash { },
+                                 const key_equal & equal = key_equal { })
+        : _values(values), _index { }, _hash(hash), _equal(equal) {
+        //at most half the slots are used, so every probe ends at an empty one
+        _index.fill(_empty);
+        for(size_type i = 0; i < N; i++) {
+            size_type slot = _home(_hash(_values[i].first));
+            while(_index[slot] != _empty) {
+                if(_equal(_values[_index[slot]].first, _values[i].first)) {
+                    throw std::invalid_argument("duplicate key in FrozenMap");
+                }
+                slot = (slot + 1) & (_capacity - 1);
+            }
+            _index[slot] = i;
+        }
+    }
+
+    constexpr size_type size() const noexcept {
+        return N;
+    }
+
+    constexpr bool empty() const noexcept {
+        return N == 0;
+    }
+
+    constexpr const_iterator begin() const noexcept {
+        return _values.data();
+    }
+    constexpr const_iterator end() const noexcept {
+        return _values.data() + N;
+    }
+
+    template <typename K>
+    constexpr const_iterator find(const K & key) const {
+        return begin() + _find_index(key);
+    }
+
+    template <typename K>
+    constexpr bool contains(const K & key) const {
+        return _find_index(key) != N;
+    }
+
+    template <typename K>
+    constexpr const T & at(const K & key) const {
+        //throws std::out_of_range for a missing key (a compile error when
+        //evaluated at compile time)
+        size_type i = _find_index(key);
+        if(i == N) {
+            throw std::out_of_range("key is not in the map");
+        }
+        return _values[i].second;
+    }
+};
+
+template <typename Key, typename T, typename Hash = fnv1a_hash, typename Pred = std::equal_to<>, size_t N>
+constexpr FrozenMap<Key, T, N, Hash, Pred> make_frozen_map(const std::pair<Key, T> (&values)[N],
+                                                           const Hash & hash = Hash { }, const Pred & equal = Pred { }) {
+    //builds a FrozenMap from a braced list of (key, mapped) pairs, N is deduced
+    std::array<std::pair<Key, T>, N> elements { };
+    for(size_t i = 0; i < N; i++)
+        elements[i] = values[i];
+    return FrozenMap<Key, T, N, Hash, Pred>(elements, hash, equal);
+}
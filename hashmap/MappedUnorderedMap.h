@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>  // std::copy
+#include <cstddef>    // size_t, ptrdiff_t
+#include <cstdint>    // uint64_t
+#include <cstring>    // std::memcmp
+#include <filesystem>
+#include <fstream>
+#include <functional> // std::hash
+#include <iterator>
+#include <stdexcept>  // std::out_of_range, std::runtime_error
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>    // std::pair, std::exchange
+#include <vector>
+
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+#include "bucket_policies.h"
+
+/*
+    A read-only string -> T map served straight out of a memory mapped file.
+
+        MappedUnorderedMap<int>::write(map, "words.idx");  // once
+        MappedUnorderedMap<int> words("words.idx");        // every start
+        const int * count = words.find("hello");
+
+    write lays any map with string keys out as one relocatable file, every
+    position in it is an offset from the start of the file:
+
+        header      magic, version, element and bucket counts, section offsets
+        buckets     bucket_count + 1 entry numbers, bucket b owns the entries
+                    [buckets[b], buckets[b + 1])
+        entries     { hash code, key offset, key length, value }, grouped by bucket
+        keys        every key's bytes back to back, in entry order
+
+    Opening a file is an mmap and a check of the header, nothing is read or
+    copied up front, so startup takes the same time for any size of file. The
+    pages are faulted in by the lookups that touch them and, being a read only
+    shared mapping of the file, are shared with every other process that maps
+    it (and survive in the page cache between runs).
+
+    A lookup hashes the key, reduces the code to a bucket with the same exact
+    modulo UnorderedMap uses by default, and walks that bucket's entries
+    comparing the stored codes first, so only a matching code reads the key
+    bytes. find returns a pointer to the value inside the mapping, and keys
+    come back as std::string_view into it: nothing is copied.
+
+    T must be trivially copyable, it is stored as raw bytes in native byte
+    order, and files are not portable between machines of different
+    endianness. The codes are stored too, so the Hash that reads a file must
+    give the same codes as the one that wrote it: a probe string's code is
+    kept in the header and a file written with another hash (or seed) is
+    refused when opened. POSIX only.
+*/
+template <typename T, typename Hash = std::hash<std::string_view>>
+class MappedUnorderedMap {
+    static_assert(std::is_trivially_copyable_v<T>, "MappedUnorderedMap stores values as raw bytes");
+
+    public:
+
+    using key_type = std::string_view;
+    using mapped_type = T;
+    using hasher = Hash;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    struct Header {
+        char magic[8];
+        uint64_t version;
+        uint64_t value_size;
+        uint64_t size;
+        uint64_t bucket_count;
+        uint64_t hash_check;
+        uint64_t buckets_offset;
+        uint64_t entries_offset;
+        uint64_t keys_offset;
+        uint64_t file_size;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t key_offset;
+        uint64_t key_length;
+        T value;
+    };
+
+    static constexpr char _magic[8] = { 'U', 'M', 'A', 'P', 'F', 'I', 'L', 'E' };
+    static constexpr uint64_t _version = 1;
+    //every section starts on a cache line
+    static constexpr uint64_t _alignment = 64;
+    static constexpr std::string_view _probe = "MappedUnorderedMap";
+
+    static_assert(alignof(Entry) <= _alignment);
+
+    const char * _data = nullptr;
+    size_type _length = 0;
+
+    const uint64_t * _buckets = nullptr;
+    const Entry * _entries = nullptr;
+    const char * _keys = nullptr;
+    size_type _size = 0;
+    prime_reciprocal_policy _range;
+
+    Hash _hash;
+
+    static uint64_t _align(uint64_t offset) {
+        return (offset + _alignment - 1) / _alignment * _alignment;
+    }
+
+    static void _pad(std::ostream & out, uint64_t from, uint64_t to) {
+        static constexpr char zeros[_alignment] = { };
+        out.write(zeros, static_cast<std::streamsize>(to - from));
+    }
+
+    std::string_view _key(const Entry & entry) const {
+        return std::string_view(_keys + entry.key_offset, entry.key_length);
+    }
+
+    const Entry * _find(std::string_view key) const {
+        uint64_t code = _hash(key);
+        size_type bucket = _range.index(code);
+        const Entry * last = _entries + _buckets[bucket + 1];
+        for(const Entry * entry = _entries + _buckets[bucket]; entry != last; entry++) {
+            if(entry->hash == code && entry->key_length == key.size() &&
+               std::memcmp(_keys + entry->key_offset, key.data(), key.size()) == 0) {
+                return entry;
+            }
+        }
+        return nullptr;
+    }
+
+    void _unmap() noexcept {
+        if(_data != nullptr) {
+            munmap(const_cast<char *>(_data), _length);
+        }
+        _data = nullptr;
+        _length = 0;
+    }
+
+    void _check(const std::filesystem::path & path) const {
+        //the header and the section bounds are validated here, so a truncated
+        //or foreign file fails to open instead of crashing a lookup later
+        auto fail = [&](const char * why) {
+            throw std::runtime_error(path.string() + ": " + why);
+        };
+        if(_length < sizeof(Header)) {
+            fail("not a mapped hash map file");
+        }
+        const Header & header = *reinterpret_cast<const Header *>(_data);
+        if(!std::equal(_magic, _magic + sizeof(_magic), header.magic)) {
+            fail("not a mapped hash map file");
+        }
+        if(header.version != _version || header.value_size != sizeof(T)) {
+            fail("written with another version or value type");
+        }
+        if(header.file_size != _length || header.bucket_count == 0 ||
+           header.buckets_offset % _alignment != 0 || header.entries_offset % _alignment != 0 ||
+           header.buckets_offset < sizeof(Header) || header.buckets_offset > _length ||
+           (_length - header.buckets_offset) / sizeof(uint64_t) <= header.bucket_count ||
+           header.entries_offset < header.buckets_offset + (header.bucket_count + 1) * sizeof(uint64_t) ||
+           header.entries_offset > _length ||
+           (_length - header.entries_offset) / sizeof(Entry) < header.size ||
+           header.keys_offset < header.entries_offset + header.size * sizeof(Entry) ||
+           header.keys_offset > _length) {
+            fail("corrupt mapped hash map file");
+        }
+        if(header.hash_check != static_cast<uint64_t>(_hash(_probe))) {
+            fail("written with a different hash function");
+        }
+        //the bucket table has to start at 0 and end at size, the rest of it
+        //and the key ranges cost a pass over every entry and are left to verify()
+        const uint64_t * buckets = reinterpret_cast<const uint64_t *>(_data + header.buckets_offset);
+        if(buckets[0] != 0 || buckets[header.bucket_count] != header.size) {
+            fail("corrupt mapped hash map file");
+        }
+    }
+
+    public:
+
+    class const_iterator {
+        friend class MappedUnorderedMap;
+
+        const MappedUnorderedMap * _map = nullptr;
+        const Entry * _entry = nullptr;
+
+        const_iterator(const MappedUnorderedMap * map, const Entry * entry)
+            : _map(map), _entry(entry) { }
+
+        public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, T>;
+        using difference_type = ptrdiff_t;
+        using reference = std::pair<std::string_view, const T &>;
+
+        //operator-> has to return something with an operator->, the pair is
+        //built on the fly from the entry
+        struct pointer {
+            reference _pair;
+            const reference * operator->() const {
+                return &_pair;
+            }
+        };
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            return reference(_map->_key(*_entry), _entry->value);
+        }
+
+        pointer operator->() const {
+            return pointer { **this };
+        }
+
+        const_iterator & operator++() {
+            _entry++;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            _entry++;
+            return previous;
+        }
+
+        bool operator==(const const_iterator & other) const {
+            return _entry == other._entry;
+        }
+    };
+
+    using iterator = const_iterator;
+
+    MappedUnorderedMap() = default;
+
+    explicit MappedUnorderedMap(const std::filesystem::path & path, const Hash & hash = Hash { })
+        : _hash(hash) {
+        //maps the file written by write, throws std::runtime_error if it can't
+        //be opened or isn't one
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0) {
+            throw std::runtime_error("could not open " + path.string());
+        }
+        struct stat status;
+        if(::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error("could not stat " + path.string());
+        }
+        _length = static_cast<size_type>(status.st_size);
+        void * data = _length > 0 ? ::mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        //the mapping keeps its own reference to the file
+        ::close(fd);
+        if(data == MAP_FAILED) {
+            _length = 0;
+            throw std::runtime_error("could not map " + path.string());
+        }
+        _data = static_cast<const char *>(data);
+
+        try {
+            _check(path);
+        } catch(...) {
+            _unmap();
+            throw;
+        }
+
+        //lookups land anywhere in the file, read-ahead would only waste page cache
+        ::madvise(data, _length, MADV_RANDOM);
+
+        const Header & header = *reinterpret_cast<const Header *>(_data);
+        _buckets = reinterpret_cast<const uint64_t *>(_data + header.buckets_offset);
+        _entries = reinterpret_cast<const Entry *>(_data + header.entries_offset);
+        _keys = _data + header.keys_offset;
+        _size = header.size;
+        _range.reset(header.bucket_count);
+    }
+
+    MappedUnorderedMap(const MappedUnorderedMap &) = delete;
+    MappedUnorderedMap & operator=(const MappedUnorderedMap &) = delete;
+
+    MappedUnorderedMap(MappedUnorderedMap && other) noexcept
+        : _data(std::exchange(other._data, nullptr)), _length(std::exchange(other._length, 0)),
+          _buckets(std::exchange(other._buckets, nullptr)), _entries(std::exchange(other._entries, nullptr)),
+          _keys(std::exchange(other._keys, nullptr)), _size(std::exchange(other._size, 0)),
+          _range(other._range), _hash(std::move(other._hash)) { }
+
+    MappedUnorderedMap & operator=(MappedUnorderedMap && other) noexcept {
+        if(this != &other) {
+            _unmap();
+            _data = std::exchange(other._data, nullptr);
+            _length = std::exchange(other._length, 0);
+            _buckets = std::exchange(other._buckets, nullptr);
+            _entries = std::exchange(other._entries, nullptr);
+            _keys = std::exchange(other._keys, nullptr);
+            _size = std::exchange(other._size, 0);
+            _range = other._range;
+            _hash = std::move(other._hash);
+        }
+        return *this;
+    }
+
+    ~MappedUnorderedMap() {
+        _unmap();
+    }
+
+    template <typename Map>
+    static void write(const Map & map, const std::filesystem::path & path, const Hash & hash = Hash { }) {
+        //writes any map whose keys convert to std::string_view (UnorderedMap,
+        //std::unordered_map, ...) in the format above. The file is written
+        //next to path and renamed over it at the end, so a process opening
+        //path sees either the old file or the complete new one.
+        //throws std::runtime_error on an I/O error
+        std::vector<std::pair<uint64_t, const typename Map::value_type *>> elements;
+        elements.reserve(map.size());
+        for(auto it = map.cbegin(); it != map.cend(); ++it) {
+            elements.emplace_back(hash(std::string_view(it->first)), &*it);
+        }
+
+        uint64_t size = elements.size();
+        prime_reciprocal_policy range;
+        uint64_t bucket_count = prime_reciprocal_policy::bucket_count_for(std::max<uint64_t>(size, 1));
+        range.reset(bucket_count);
+
+        //counting sort by bucket, buckets[b + 1] first counts bucket b
+        std::vector<uint64_t> buckets(bucket_count + 1, 0);
+        for(const auto & element : elements) {
+            buckets[range.index(element.first) + 1]++;
+        }
+        for(uint64_t b = 0; b < bucket_count; b++) {
+            buckets[b + 1] += buckets[b];
+        }
+        std::vector<uint64_t> next(buckets.begin(), buckets.end() - 1);
+        std::vector<const std::pair<uint64_t, const typename Map::value_type *> *> order(size);
+        for(const auto & element : elements) {
+            order[next[range.index(element.first)]++] = &element;
+        }
+
+        Header header = { };
+        std::copy(_magic, _magic + sizeof(_magic), header.magic);
+        header.version = _version;
+        header.value_size = sizeof(T);
+        header.size = size;
+        header.bucket_count = bucket_count;
+        header.hash_check = hash(_probe);
+        header.buckets_offset = _align(sizeof(Header));
+        header.entries_offset = _align(header.buckets_offset + buckets.size() * sizeof(uint64_t));
+        header.keys_offset = _align(header.entries_offset + size * sizeof(Entry));
+        uint64_t key_bytes = 0;
+        for(const auto & element : elements) {
+            key_bytes += std::string_view(element.second->first).size();
+        }
+        header.file_size = header.keys_offset + key_bytes;
+
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if(!out) {
+                throw std::runtime_error("could not open " + temporary.string());
+            }
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            _pad(out, sizeof(header), header.buckets_offset);
+            out.write(reinterpret_cast<const char *>(buckets.data()),
+                      static_cast<std::streamsize>(buckets.size() * sizeof(uint64_t)));
+            _pad(out, header.buckets_offset + buckets.size() * sizeof(uint64_t), header.entries_offset);
+
+            uint64_t key_offset = 0;
+            for(const auto * element : order) {
+                //zeroed first so padding inside Entry doesn't leak stack bytes into the file
+                Entry entry;
+                std::memset(static_cast<void *>(&entry), 0, sizeof(entry));
+                entry.hash = element->first;
+                entry.key_offset = key_offset;
+                entry.key_length = std::string_view(element->second->first).size();
+                entry.value = element->second->second;
+                out.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+                key_offset += entry.key_length;
+            }
+            _pad(out, header.entries_offset + size * sizeof(Entry), header.keys_offset);
+
+            for(const auto * element : order) {
+                std::string_view key(element->second->first);
+                out.write(key.data(), static_cast<std::streamsize>(key.size()));
+            }
+            out.flush();
+            if(!out) {
+                throw std::runtime_error("could not write " + temporary.string());
+            }
+        }
+        std::filesystem::rename(temporary, path);
+    }
+
+    size_type size() const noexcept {
+        return _size;
+    }
+
+    bool empty() const noexcept {
+        return _size == 0;
+    }
+
+    size_type bucket_count() const noexcept {
+        return _range._bucket_count;
+    }
+
+    size_type file_size() const noexcept {
+        return _length;
+    }
+
+    const_iterator begin() const noexcept {
+        //entries come out in file order, which is bucket order
+        return const_iterator(this, _entries);
+    }
+    const_iterator end() const noexcept {
+        return const_iterator(this, _entries + _size);
+    }
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    const T * find(std::string_view key) const {
+        //a pointer to key's value inside the mapping, or nullptr if key is missing
+        if(_data == nullptr) {
+            return nullptr;
+        }
+        const Entry * entry = _find(key);
+        return entry != nullptr ? &entry->value : nullptr;
+    }
+
+    bool contains(std::string_view key) const {
+        return find(key) != nullptr;
+    }
+
+    const T & at(std::string_view key) const {
+        const T * value = find(key);
+        if(value == nullptr) {
+            throw std::out_of_range("key is not in the map");
+        }
+        return *value;
+    }
+
+    bool verify() const {
+        //walks every entry and checks that its key lies inside the file and its
+        //code matches the bucket it's stored in, for files from an untrusted
+        //source. Opening only checks the header, which is what keeps it O(1)
+        //a map with no file (default constructed or moved from) has nothing to check
+        if(_data == nullptr) {
+            return true;
+        }
+        uint64_t key_bytes = _length - (_keys - _data);
+        for(size_type b = 0; b < bucket_count(); b++) {
+            if(_buckets[b] > _buckets[b + 1] || _buckets[b + 1] > _size) {
+                return false;
+            }
+            for(uint64_t i = _buckets[b]; i < _buckets[b + 1]; i++) {
+                const Entry & entry = _entries[i];
+                if(entry.key_offset > key_bytes || entry.key_length > key_bytes - entry.key_offset ||
+                   _range.index(entry.hash) != b) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
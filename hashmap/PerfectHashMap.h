@@ -0,0 +1,565 @@
+#pragma once
+
+#include <algorithm>  // std::max, std::sort
+#include <cmath>      // std::ceil
+#include <cstddef>    // size_t
+#include <cstdint>    // uint16_t, uint64_t, SIZE_MAX
+#include <filesystem>
+#include <fstream>
+#include <functional> // std::hash
+#include <initializer_list>
+#include <istream>
+#include <ostream>
+#include <ranges>
+#include <stdexcept>  // std::out_of_range, std::invalid_argument, std::runtime_error
+#include <string>
+#include <type_traits>
+#include <utility>    // std::pair
+#include <vector>
+
+#include "bucket_policies.h"
+#include "hash_functions.h"
+
+/*
+    A read-only hash map built once from a fixed key set, with a minimal
+    perfect hash function in front of a plain array of the elements.
+
+    The function is PTHash style: every key's hash code is mixed with a seed
+    and sent to one of about size / 4 buckets, and every bucket has a small
+    "pilot" number chosen at build time. A key's position is a mix of its
+    code and its bucket's pilot, reduced to [0, size / 0.98). The builder
+    handles the buckets largest first and tries pilots 0, 1, 2, ... until
+    every key of the bucket lands on a position nobody has taken, so in the
+    end every key has a position of its own. The 2% of positions past size
+    are mapped onto the holes below size through a small remap table.
+
+    A lookup is then: hash, mix, read one pilot, mix, (remap), compare one
+    key. There are no probes and no branches besides the key comparison.
+    The extra memory is 2 bytes of pilot per 4 keys plus the remap table,
+    the elements themselves sit back to back in iteration order = slot order.
+
+    Mapped values may be changed through iterators, keys can't be added or
+    removed, build a new map for that.
+
+    save/load write and read the table to a file (native byte order) for
+    keys and mapped values that are trivially copyable or std::basic_string.
+    The hash codes are not stored, so load needs a Hash that gives the same
+    codes as the one used for the build (the same seed for a seeded hash).
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class PerfectHashMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using iterator = value_type *;
+    using const_iterator = const value_type *;
+
+    private:
+
+    using pilot_type = uint16_t;
+
+    //keys per bucket on average and the share of positions that get a key,
+    //the usual PTHash trade-off between build time and space
+    static constexpr double _keys_per_bucket = 4.0;
+    static constexpr double _fill = 0.98;
+    //a bucket that finds no free positions with any pilot makes the builder
+    //start over with the next seed
+    static constexpr size_type _max_pilot = 0xFFFF;
+    static constexpr size_type _max_attempts = 64;
+
+    static constexpr char _magic[8] = { 'P', 'H', 'M', 'A', 'P', '0', '0', '1' };
+
+    static constexpr bool _transparent = requires {
+        typename Hash::is_transparent;
+        typename Pred::is_transparent;
+    };
+
+    uint64_t _seed;
+    size_type _position_count;
+    fastrange_policy _bucket_range;
+    fastrange_policy _position_range;
+    std::vector<pilot_type> _pilots;
+    //_remap[p - size] is the slot of position p >= size, _remap[0] also stands
+    //in for every position below size so a lookup never branches on it
+    std::vector<size_type> _remap;
+    std::vector<value_type> _values;
+
+    Hash _hash;
+    key_equal _equal;
+
+    static uint64_t _mix(uint64_t x) {
+        return integer_hash{}(x);
+    }
+
+    uint64_t _seeded(size_t code) const {
+        return _mix(code ^ _seed);
+    }
+
+    size_type _position(uint64_t seeded, pilot_type pilot) const {
+        //the position of a key with seeded code seeded in a bucket with pilot
+        return _position_range.index(_mix(seeded ^ (pilot * 0x9E3779B97F4A7C15ull)));
+    }
+
+    size_type _slot(size_t code) const {
+        //the only slot a key with hash code can be in
+        uint64_t seeded = _seeded(code);
+        size_type position = _position(seeded, _pilots[_bucket_range.index(seeded)]);
+        bool remapped = position >= _values.size();
+        size_type slot = _remap[remapped ? position - _values.size() : 0];
+        return remapped ? slot : position;
+    }
+
+    template <typename K>
+    size_type _find_index(const K & key) const {
+        //returns the slot holding key, or size() if key is not in the map
+        size_type slot = _slot(_hash(key));
+        return slot < _values.size() && _equal(_values[slot].first, key) ? slot : _values.size();
+    }
+
+    static size_type _bucket_count_for(size_type n) {
+        return std::max<size_type>(static_cast<size_type>(std::ceil(n / _keys_per_bucket)), 1);
+    }
+
+    static size_type _position_count_for(size_type n) {
+        return std::max<size_type>({ n, static_cast<size_type>(std::ceil(n / _fill)), 1 });
+    }
+
+    void _reset_empty() {
+        //an empty map still answers lookups (with end()) without special cases
+        _seed = 0;
+        _position_count = 1;
+        _bucket_range.reset(1);
+        _position_range.reset(1);
+        _pilots.assign(1, 0);
+        _remap.assign(1, 0);
+        _values.clear();
+    }
+
+    static void _drop_duplicates(std::vector<std::pair<Key, T>> & items, std::vector<size_t> & codes,
+                                 const key_equal & equal) {
+        //the last of several equal keys wins, as with repeated UnorderedMap::insert
+        //two different keys with the same hash code can never be told apart by
+        //a function of the code, so those are an error
+        std::vector<size_type> order(items.size());
+        for(size_type i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_type a, size_type b) {
+            return codes[a] != codes[b] ? codes[a] < codes[b] : a < b;
+        });
+
+        std::vector<bool> dropped(items.size());
+        bool any = false;
+        for(size_type i = 0; i + 1 < order.size(); i++) {
+            if(codes[order[i]] == codes[order[i + 1]]) {
+                if(!equal(items[order[i]].first, items[order[i + 1]].first)) {
+                    throw std::invalid_argument("two keys have the same hash code");
+                }
+                //order[i + 1] came later in the input
+                dropped[order[i]] = true;
+                any = true;
+            }
+        }
+        if(!any) {
+            return;
+        }
+
+        size_type kept = 0;
+        for(size_type i = 0; i < items.size(); i++) {
+            if(!dropped[i]) {
+                if(kept != i) {
+                    items[kept] = std::move(items[i]);
+                    codes[kept] = codes[i];
+                }
+                kept++;
+            }
+        }
+        items.resize(kept);
+        codes.resize(kept);
+    }
+
+    bool _find_pilots(const std::vector<size_t> & codes) {
+        //picks a pilot for every bucket under the current _seed
+        //returns false if some bucket found none
+        size_type n = codes.size();
+        size_type positions = _position_count;
+        size_type buckets = _pilots.size();
+
+        //keys grouped by bucket (counting sort)
+        std::vector<uint64_t> seeded(n);
+        std::vector<size_type> start(buckets + 1);
+        for(size_type i = 0; i < n; i++) {
+            seeded[i] = _seeded(codes[i]);
+            start[_bucket_range.index(seeded[i]) + 1]++;
+        }
+        for(size_type b = 0; b < buckets; b++)
+            start[b + 1] += start[b];
+        std::vector<uint64_t> grouped(n);
+        std::vector<size_type> fill(start.begin(), start.end() - 1);
+        for(size_type i = 0; i < n; i++)
+            grouped[fill[_bucket_range.index(seeded[i])]++] = seeded[i];
+
+        //largest buckets first, while most positions are still free
+        std::vector<size_type> order(buckets);
+        for(size_type b = 0; b < buckets; b++)
+            order[b] = b;
+        std::stable_sort(order.begin(), order.end(), [&](size_type a, size_type b) {
+            return start[a + 1] - start[a] > start[b + 1] - start[b];
+        });
+
+        std::vector<bool> taken(positions);
+        std::vector<size_type> placed;
+        for(size_type b : order) {
+            size_type first = start[b], last = start[b + 1];
+            if(first == last) {
+                break;
+            }
+            bool found = false;
+            for(size_type pilot = 0; pilot <= _max_pilot && !found; pilot++) {
+                //mark as we go (which also catches two keys of the bucket on
+                //one position) and undo on a clash
+                placed.clear();
+                found = true;
+                for(size_type i = first; i < last; i++) {
+                    size_type position = _position(grouped[i], static_cast<pilot_type>(pilot));
+                    if(taken[position]) {
+                        found = false;
+                        break;
+                    }
+                    taken[position] = true;
+                    placed.push_back(position);
+                }
+                if(found) {
+                    _pilots[b] = static_cast<pilot_type>(pilot);
+                } else {
+                    for(size_type position : placed)
+                        taken[position] = false;
+                }
+            }
+            if(!found) {
+                return false;
+            }
+        }
+
+        //every taken position past n gets one of the free slots below n
+        _remap.assign(std::max<size_type>(positions - n, 1), 0);
+        size_type hole = 0;
+        for(size_type position = n; position < positions; position++) {
+            if(taken[position]) {
+                while(taken[hole]) {
+                    hole++;
+                }
+                _remap[position - n] = hole++;
+            }
+        }
+        return true;
+    }
+
+    void _build(std::vector<std::pair<Key, T>> & items) {
+        std::vector<size_t> codes(items.size());
+        for(size_type i = 0; i < items.size(); i++)
+            codes[i] = _hash(items[i].first);
+        _drop_duplicates(items, codes, _equal);
+
+        size_type n = items.size();
+        if(n == 0) {
+            _reset_empty();
+            return;
+        }
+
+        size_type buckets = _bucket_count_for(n);
+        size_type positions = _position_count_for(n);
+        _position_count = positions;
+        _bucket_range.reset(buckets);
+        _position_range.reset(positions);
+
+        //the seeds are fixed, so the same keys always give the same table
+        bool built = false;
+        for(size_type attempt = 0; attempt < _max_attempts && !built; attempt++) {
+            _seed = _mix(attempt + 1);
+            _pilots.assign(buckets, 0);
+            built = _find_pilots(codes);
+        }
+        if(!built) {
+            throw std::runtime_error("no perfect hash function found for the key set");
+        }
+
+        //the elements go into their slots, which is also the iteration order
+        std::vector<size_type> owner(n);
+        for(size_type i = 0; i < n; i++) {
+            size_type position = _position(_seeded(codes[i]), _pilots[_bucket_range.index(_seeded(codes[i]))]);
+            owner[position < n ? position : _remap[position - n]] = i;
+        }
+        _values.clear();
+        _values.reserve(n);
+        for(size_type slot = 0; slot < n; slot++)
+            _values.emplace_back(std::move(items[owner[slot]].first), std::move(items[owner[slot]].second));
+    }
+
+    //file helpers, trivially copyable values are written as their bytes and
+    //strings as a 64 bit length followed by the characters
+
+    template <typename V>
+    static constexpr bool _is_string(const V *) {
+        return false;
+    }
+
+    template <typename C, typename Traits, typename A>
+    static constexpr bool _is_string(const std::basic_string<C, Traits, A> *) {
+        return std::is_trivially_copyable_v<C>;
+    }
+
+    template <typename V>
+    static constexpr bool _serializable = std::is_trivially_copyable_v<V> || _is_string(static_cast<const V *>(nullptr));
+
+    static void _write_bytes(std::ostream & out, const void * data, size_type bytes) {
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+    }
+
+    static void _read_bytes(std::istream & in, void * data, size_type bytes) {
+        if(!in.read(static_cast<char *>(data), static_cast<std::streamsize>(bytes))) {
+            throw std::runtime_error("perfect hash map file is truncated");
+        }
+    }
+
+    template <typename Sequence>
+    static void _read_pieces(std::istream & in, Sequence & out, uint64_t count) {
+        //reads count elements into out (a vector or string of trivially copyable
+        //elements) in pieces, grown as they arrive, so a corrupt count fails in
+        //_read_bytes once the file runs out instead of allocating it all up front
+        using element = typename Sequence::value_type;
+        constexpr size_type piece = (size_type(1) << 16) / sizeof(element);
+        out.clear();
+        while(out.size() < count) {
+            size_type done = out.size();
+            size_type m = static_cast<size_type>(std::min<uint64_t>(count - done, piece));
+            out.resize(done + m);
+            _read_bytes(in, out.data() + done, m * sizeof(element));
+        }
+    }
+
+    template <typename V>
+    static void _write_value(std::ostream & out, const V & value) {
+        if constexpr (std::is_trivially_copyable_v<V>) {
+            _write_bytes(out, &value, sizeof(V));
+        } else {
+            uint64_t length = value.size();
+            _write_bytes(out, &length, sizeof(length));
+            _write_bytes(out, value.data(), length * sizeof(typename V::value_type));
+        }
+    }
+
+    template <typename V>
+    static V _read_value(std::istream & in) {
+        if constexpr (std::is_trivially_copyable_v<V>) {
+            V value;
+            _read_bytes(in, &value, sizeof(V));
+            return value;
+        } else {
+            uint64_t length;
+            _read_bytes(in, &length, sizeof(length));
+            V value;
+            _read_pieces(in, value, length);
+            return value;
+        }
+    }
+
+    public:
+
+    explicit PerfectHashMap(const Hash & hash = Hash { }, const key_equal & equal = key_equal { })
+        : _hash(hash), _equal(equal) {
+        _reset_empty();
+    }
+
+    template <std::ranges::input_range Values>
+        requires (!std::is_same_v<std::remove_cvref_t<Values>, PerfectHashMap>)
+    explicit PerfectHashMap(Values && values, const Hash & hash = Hash { }, const key_equal & equal = key_equal { })
+        : _hash(hash), _equal(equal) {
+        //builds the map from (key, mapped) pairs, a key given twice keeps the
+        //last mapped value
+        //throws std::invalid_argument if two different keys share a hash code
+        std::vector<std::pair<Key, T>> items;
+        if constexpr (std::ranges::sized_range<Values>) {
+            items.reserve(std::ranges::size(values));
+        }
+        for(auto && value : values)
+            items.emplace_back(value.first, value.second);
+        _build(items);
+    }
+
+    PerfectHashMap(std::initializer_list<std::pair<Key, T>> values, const Hash & hash = Hash { },
+                   const key_equal & equal = key_equal { })
+        : _hash(hash), _equal(equal) {
+        std::vector<std::pair<Key, T>> items(values);
+        _build(items);
+    }
+
+    size_type size() const noexcept {
+        return _values.size();
+    }
+
+    bool empty() const noexcept {
+        return _values.empty();
+    }
+
+    iterator begin() {
+        return _values.data();
+    }
+    iterator end() {
+        return _values.data() + _values.size();
+    }
+
+    const_iterator cbegin() const {
+        return _values.data();
+    }
+    const_iterator cend() const {
+        return _values.data() + _values.size();
+    }
+
+    iterator find(const Key & key) {
+        return begin() + _find_index(key);
+    }
+
+    const_iterator find(const Key & key) const {
+        return cbegin() + _find_index(key);
+    }
+
+    template <typename K>
+        requires _transparent
+    iterator find(const K & key) {
+        return begin() + _find_index(key);
+    }
+
+    template <typename K>
+        requires _transparent
+    const_iterator find(const K & key) const {
+        return cbegin() + _find_index(key);
+    }
+
+    bool contains(const Key & key) const {
+        return _find_index(key) != size();
+    }
+
+    template <typename K>
+        requires _transparent
+    bool contains(const K & key) const {
+        return _find_index(key) != size();
+    }
+
+    T & at(const Key & key) {
+        size_type slot = _find_index(key);
+        if(slot == size()) {
+            throw std::out_of_range("key is not in the map");
+        }
+        return _values[slot].second;
+    }
+
+    const T & at(const Key & key) const {
+        size_type slot = _find_index(key);
+        if(slot == size()) {
+            throw std::out_of_range("key is not in the map");
+        }
+        return _values[slot].second;
+    }
+
+    size_type bucket_count() const noexcept {
+        //the number of pilots
+        return _pilots.size();
+    }
+
+    size_type memory_overhead() const noexcept {
+        //bytes used besides the elements themselves
+        return _pilots.size() * sizeof(pilot_type) + _remap.size() * sizeof(size_type);
+    }
+
+    void save(std::ostream & out) const
+        requires _serializable<Key> && _serializable<T> {
+        uint64_t header[5] = { _values.size(), _position_count, _pilots.size(), _seed, _remap.size() };
+        _write_bytes(out, _magic, sizeof(_magic));
+        _write_bytes(out, header, sizeof(header));
+        _write_bytes(out, _pilots.data(), _pilots.size() * sizeof(pilot_type));
+        for(size_type slot : _remap) {
+            uint64_t value = slot;
+            _write_bytes(out, &value, sizeof(value));
+        }
+        for(const value_type & value : _values) {
+            _write_value(out, value.first);
+            _write_value(out, value.second);
+        }
+        if(!out) {
+            throw std::runtime_error("could not write perfect hash map");
+        }
+    }
+
+    void save(const std::filesystem::path & path) const
+        requires _serializable<Key> && _serializable<T> {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if(!out) {
+            throw std::runtime_error("could not open " + path.string());
+        }
+        save(out);
+    }
+
+    static PerfectHashMap load(std::istream & in, const Hash & hash = Hash { }, const key_equal & equal = key_equal { })
+        requires _serializable<Key> && _serializable<T> {
+        //reads a map written by save
+        //throws std::runtime_error if the data is not one
+        //the header is checked against what the builder would derive from its
+        //size, and nothing is allocated ahead of the data that fills it
+        char magic[sizeof(_magic)];
+        _read_bytes(in, magic, sizeof(magic));
+        if(!std::equal(magic, magic + sizeof(magic), _magic)) {
+            throw std::runtime_error("not a perfect hash map file");
+        }
+        uint64_t header[5];
+        _read_bytes(in, header, sizeof(header));
+        auto [size, positions, buckets, seed, remap] = header;
+        //more elements than fit in memory would also overflow the counts below
+        if(size > SIZE_MAX / sizeof(value_type) || buckets != _bucket_count_for(size)
+           || positions != _position_count_for(size) || remap != std::max<uint64_t>(positions - size, 1)) {
+            throw std::runtime_error("corrupt perfect hash map file");
+        }
+
+        PerfectHashMap map(hash, equal);
+        map._seed = seed;
+        map._position_count = positions;
+        map._bucket_range.reset(buckets);
+        map._position_range.reset(positions);
+        _read_pieces(in, map._pilots, buckets);
+        map._remap.clear();
+        for(uint64_t i = 0; i < remap; i++) {
+            uint64_t value;
+            _read_bytes(in, &value, sizeof(value));
+            if(size > 0 && value >= size) {
+                throw std::runtime_error("corrupt perfect hash map file");
+            }
+            map._remap.push_back(value);
+        }
+        map._values.reserve(std::min<uint64_t>(size, size_type(1) << 16));
+        for(uint64_t i = 0; i < size; i++) {
+            Key key = _read_value<Key>(in);
+            T mapped = _read_value<T>(in);
+            map._values.emplace_back(std::move(key), std::move(mapped));
+        }
+        return map;
+    }
+
+    static PerfectHashMap load(const std::filesystem::path & path, const Hash & hash = Hash { },
+                               const key_equal & equal = key_equal { })
+        requires _serializable<Key> && _serializable<T> {
+        std::ifstream in(path, std::ios::binary);
+        if(!in) {
+            throw std::runtime_error("could not open " + path.string());
+        }
+        return load(in, hash, equal);
+    }
+};
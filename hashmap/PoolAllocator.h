@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>  // std::max
+#include <cstddef>    // size_t, std::max_align_t
+#include <memory>     // std::shared_ptr
+#include <new>        // operator new
+#include <type_traits> // std::true_type
+#include <vector>
+
+//the memory behind a PoolAllocator, shared by all of its copies and rebinds
+template <size_t ChunkBytes>
+class NodePool {
+    public:
+
+    struct FreeBlock {
+        FreeBlock * next;
+    };
+
+    //size of every block handed out by this pool, fixed by the first
+    //single object allocation (0 until then)
+    size_t block_size = 0;
+    std::vector<char *> chunks;
+    FreeBlock * free_list = nullptr;
+    //unused tail of the newest chunk
+    char * cursor = nullptr;
+    char * end = nullptr;
+
+    NodePool() = default;
+    NodePool(const NodePool &) = delete;
+    NodePool & operator=(const NodePool &) = delete;
+
+    ~NodePool() {
+        release();
+    }
+
+    void * allocate_block() {
+        if(free_list) {
+            FreeBlock * block = free_list;
+            free_list = block->next;
+            return block;
+        }
+        if(cursor == end) {
+            size_t blocks = std::max<size_t>(ChunkBytes / block_size, 1);
+            char * chunk = static_cast<char *>(::operator new(blocks * block_size));
+            chunks.push_back(chunk);
+            cursor = chunk;
+            end = chunk + blocks * block_size;
+        }
+        void * block = cursor;
+        cursor += block_size;
+        return block;
+    }
+
+    void deallocate_block(void * p) {
+        FreeBlock * block = static_cast<FreeBlock *>(p);
+        block->next = free_list;
+        free_list = block;
+    }
+
+    void adopt(NodePool & other) {
+        //takes over every chunk of other, blocks it handed out can then be
+        //deallocated here, and its free blocks (and unused tail) are reused here
+        //both pools must have the same block size (or other none yet)
+        if(other.block_size == 0) {
+            return;
+        }
+        block_size = other.block_size;
+        chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+        other.chunks.clear();
+        for(char * block = other.cursor; block != other.end; block += block_size)
+            deallocate_block(block);
+        while(other.free_list) {
+            FreeBlock * block = other.free_list;
+            other.free_list = block->next;
+            deallocate_block(block);
+        }
+        other.cursor = nullptr;
+        other.end = nullptr;
+    }
+
+    void release() {
+        for(char * chunk : chunks)
+            ::operator delete(chunk);
+        chunks.clear();
+        free_list = nullptr;
+        cursor = nullptr;
+        end = nullptr;
+    }
+};
+
+/*
+    Slab allocator for node based containers such as UnorderedMap.
+
+    Single object allocations are carved out of large chunks and recycled
+    through an intrusive free list, so building a map does one malloc per
+    chunk instead of one per node and the nodes end up packed together.
+    Anything else (arrays, over-aligned or differently sized types) goes
+    straight to operator new.
+
+    Copies and rebinds of an allocator share the same pool, as the allocator
+    requirements demand. A container that holds the only reference to its pool
+    (see exclusive()) may call release() to hand back every chunk at once
+    instead of deallocating its nodes one by one, as long as its nodes really
+    came from the pool (see pooled()). Copy constructing a container
+    gives the copy a pool of its own (select_on_container_copy_construction).
+
+    Not thread safe: a pool must only be used by one thread at a time.
+*/
+template <typename T, size_t ChunkBytes = 64 * 1024>
+class PoolAllocator {
+    template <typename U, size_t Bytes>
+    friend class PoolAllocator;
+
+    using Pool = NodePool<ChunkBytes>;
+
+    std::shared_ptr<Pool> _pool;
+
+    static constexpr size_t _block_size() {
+        //blocks are max_align_t aligned and big enough to hold a free list link
+        size_t align = alignof(std::max_align_t);
+        size_t size = std::max(sizeof(T), sizeof(typename Pool::FreeBlock));
+        return (size + align - 1) / align * align;
+    }
+
+    bool _pooled(size_t n) const {
+        //only single objects of the pool's block size come from the pool
+        if(n != 1 || alignof(T) > alignof(std::max_align_t)) {
+            return false;
+        }
+        if(_pool->block_size == 0) {
+            _pool->block_size = _block_size();
+        }
+        return _pool->block_size == _block_size();
+    }
+
+    public:
+
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, ChunkBytes>;
+    };
+
+    PoolAllocator() : _pool(std::make_shared<Pool>()) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, ChunkBytes> & other) noexcept : _pool(other._pool) {}
+
+    T * allocate(size_t n) {
+        if(_pooled(n)) {
+            return static_cast<T *>(_pool->allocate_block());
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T * p, size_t n) noexcept {
+        if(_pooled(n)) {
+            _pool->deallocate_block(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    PoolAllocator select_on_container_copy_construction() const {
+        return PoolAllocator();
+    }
+
+    bool exclusive() const noexcept {
+        //true when no other allocator (and so no other container) uses our pool
+        return _pool.use_count() == 1;
+    }
+
+    bool pooled() const noexcept {
+        //true when single T allocations come from the pool, so release() frees
+        //them; over-aligned types and types whose block size differs from the
+        //one the pool was set up with go to operator new and must be
+        //deallocated one by one
+        return alignof(T) <= alignof(std::max_align_t) && _pool->block_size == _block_size();
+    }
+
+    void release() noexcept {
+        //returns every chunk to the system at once
+        //everything allocated from the pool must already be destroyed
+        _pool->release();
+    }
+
+    template <typename U>
+    void adopt(PoolAllocator<U, ChunkBytes> & other) {
+        //moves every chunk of other's pool into ours, so memory allocated through
+        //other (from another thread, say) can be freed and reused through us
+        //other's pool is left empty, with nothing it handed out still in it
+        if(_pool != other._pool) {
+            _pool->adopt(*other._pool);
+        }
+    }
+
+    size_t chunk_count() const noexcept {
+        return _pool->chunks.size();
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, ChunkBytes> & other) const noexcept {
+        return _pool == other._pool;
+    }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, ChunkBytes> & other) const noexcept {
+        return _pool != other._pool;
+    }
+};
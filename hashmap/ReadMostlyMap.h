@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>  // std::max
+#include <atomic>
+#include <cstddef>    // size_t
+#include <functional> // std::hash, std::equal_to
+#include <memory>     // std::unique_ptr
+#include <mutex>      // std::mutex, std::lock_guard
+#include <optional>
+#include <utility>    // std::pair, std::forward
+
+#include "bucket_policies.h"
+#include "epoch_reclamation.h"
+
+/*
+    A concurrent hash map for tables that are read all the time and written
+    rarely, where even a shared lock costs too much: every shared_mutex
+    acquisition writes the lock's cache line, which then bounces between all
+    the reading cores.
+
+    Readers take no locks and write no shared memory. A lookup announces
+    itself in its thread's epoch record (see epoch_reclamation.h), loads the
+    current table and walks one chain with acquire loads. Nodes are never
+    changed once published: a writer builds a new node completely, then
+    links it in with one release store, so a reader sees either the old
+    chain or the new one, never a half built node. Replacing a value swaps
+    in a new node, erasing unlinks one, and the old node is retired and
+    freed once no reader can still be on it.
+
+    Writers are serialized by a single mutex, which is fine for a few
+    updates per second but makes this the wrong map for a write heavy load
+    (use ConcurrentUnorderedMap there). Growing copies every node into a
+    new table, since the old chains must stay intact for readers still
+    walking them, so give the expected size to the constructor.
+
+    Callbacks passed to find_and_apply run inside the reader's epoch and
+    must not block on a writer. There are no iterators.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename RangePolicy = prime_modulo_policy>
+class ReadMostlyMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = size_t;
+
+    private:
+
+    struct Node {
+        std::atomic<Node *> next;
+        size_t hash;
+        value_type value;
+
+        template <typename K, typename M>
+        Node(Node * next, size_t hash, K && key, M && mapped)
+            : next(next), hash(hash), value(std::forward<K>(key), std::forward<M>(mapped)) {}
+    };
+
+    //a bucket array and the nodes linked from it, replaced as a whole when
+    //the map grows or is cleared
+    struct Table {
+        size_type bucket_count;
+        RangePolicy range;
+        std::unique_ptr<std::atomic<Node *>[]> buckets;
+
+        explicit Table(size_type n)
+            : bucket_count(RangePolicy::bucket_count_for(std::max<size_type>(n, 1))),
+              buckets(new std::atomic<Node *>[bucket_count]()) {
+            range.reset(bucket_count);
+        }
+
+        ~Table() {
+            for(size_type i = 0; i < bucket_count; i++) {
+                Node * node = buckets[i].load(std::memory_order_relaxed);
+                while(node) {
+                    Node * next = node->next.load(std::memory_order_relaxed);
+                    delete node;
+                    node = next;
+                }
+            }
+        }
+
+        std::atomic<Node *> & bucket(size_t code) const {
+            return buckets[range.index(code)];
+        }
+    };
+
+    std::atomic<Table *> _table;
+    std::atomic<size_type> _size = 0;
+
+    Hash _hash;
+    key_equal _equal;
+
+    //everything below is only touched with _write_lock held
+    std::mutex _write_lock;
+    retired_list _retired;
+
+    std::atomic<Node *> * _find_link(Table * table, const Key & key, size_t code) {
+        //returns the link pointing at key's node, or nullptr if key is
+        //missing; for writers, whose nodes nobody else can free
+        std::atomic<Node *> * link = &table->bucket(code);
+        for(Node * node = link->load(std::memory_order_relaxed); node;
+            link = &node->next, node = link->load(std::memory_order_relaxed)) {
+            if(node->hash == code && _equal(node->value.first, key)) {
+                return link;
+            }
+        }
+        return nullptr;
+    }
+
+    Table * _grow(Table * table) {
+        //copies every node into a table of the RangePolicy's next size and publishes it
+        std::unique_ptr<Table> grown = std::make_unique<Table>(table->bucket_count + 1);
+        for(size_type i = 0; i < table->bucket_count; i++) {
+            for(Node * node = table->buckets[i].load(std::memory_order_relaxed); node;
+                node = node->next.load(std::memory_order_relaxed)) {
+                std::atomic<Node *> & bucket = grown->bucket(node->hash);
+                bucket.store(new Node(bucket.load(std::memory_order_relaxed), node->hash, node->value.first,
+                                      node->value.second),
+                             std::memory_order_relaxed);
+            }
+        }
+        _table.store(grown.get(), std::memory_order_release);
+        Table * published = grown.release();
+        _retired.retire(table);
+        return published;
+    }
+
+    template <typename M, typename F>
+    bool _insert(const Key & key, M && value, F && update) {
+        //inserts (key, value) if key is missing, otherwise replaces key's node
+        //with a copy that update(T &) is applied to
+        size_t code = _hash(key);
+        std::lock_guard guard(_write_lock);
+        Table * table = _table.load(std::memory_order_relaxed);
+        bool inserted = false;
+        if(std::atomic<Node *> * link = _find_link(table, key, code)) {
+            Node * old = link->load(std::memory_order_relaxed);
+            Node * fresh = new Node(old->next.load(std::memory_order_relaxed), code, old->value.first,
+                                    old->value.second);
+            update(fresh->value.second);
+            link->store(fresh, std::memory_order_release);
+            _retired.retire(old);
+        } else {
+            if(_size.load(std::memory_order_relaxed) + 1 > table->bucket_count) {
+                table = _grow(table);
+            }
+            std::atomic<Node *> & bucket = table->bucket(code);
+            bucket.store(new Node(bucket.load(std::memory_order_relaxed), code, key, std::forward<M>(value)),
+                         std::memory_order_release);
+            _size.fetch_add(1, std::memory_order_relaxed);
+            inserted = true;
+        }
+        _retired.reclaim();
+        return inserted;
+    }
+
+    public:
+
+    explicit ReadMostlyMap(size_type bucket_count = 0, const Hash & hash = Hash { },
+                           const key_equal & equal = key_equal { })
+        : _table(new Table(bucket_count)), _hash(hash), _equal(equal) {}
+
+    ReadMostlyMap(const ReadMostlyMap &) = delete;
+    ReadMostlyMap & operator=(const ReadMostlyMap &) = delete;
+
+    ~ReadMostlyMap() {
+        //no reader may be left, the retired list frees the rest
+        delete _table.load(std::memory_order_relaxed);
+    }
+
+    template <typename M>
+    bool insert_or_update(const Key & key, M && value) {
+        //inserts (key, value) or replaces key's mapped value with value
+        //returns true if key was inserted
+        //only one of the two uses of value runs
+        return _insert(key, std::forward<M>(value), [&](T & mapped) { mapped = std::forward<M>(value); });
+    }
+
+    template <typename M, typename F>
+    bool insert_or_update(const Key & key, M && value, F && update) {
+        //inserts (key, value) if key is missing, otherwise calls update(T &)
+        //on a copy of the mapped value that then replaces it
+        //returns true if key was inserted
+        return _insert(key, std::forward<M>(value), update);
+    }
+
+    template <typename F>
+    bool find_and_apply(const Key & key, F && apply) const {
+        //calls apply(const T &) on key's mapped value if key is present
+        //returns whether key was found
+        size_t code = _hash(key);
+        epoch_guard guard;
+        const Table * table = _table.load(std::memory_order_acquire);
+        for(const Node * node = table->bucket(code).load(std::memory_order_acquire); node;
+            node = node->next.load(std::memory_order_acquire)) {
+            if(node->hash == code && _equal(node->value.first, key)) {
+                apply(node->value.second);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::optional<T> find(const Key & key) const {
+        //a copy of key's mapped value, the node itself may be freed as soon
+        //as the lookup returns
+        std::optional<T> found;
+        find_and_apply(key, [&](const T & value) { found.emplace(value); });
+        return found;
+    }
+
+    bool contains(const Key & key) const {
+        return find_and_apply(key, [](const T &) {});
+    }
+
+    bool erase(const Key & key) {
+        //returns whether key was removed
+        size_t code = _hash(key);
+        std::lock_guard guard(_write_lock);
+        std::atomic<Node *> * link = _find_link(_table.load(std::memory_order_relaxed), key, code);
+        if(!link) {
+            return false;
+        }
+        Node * node = link->load(std::memory_order_relaxed);
+        //readers already on node still follow its next pointer, which stays valid
+        link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        _retired.retire(node);
+        _retired.reclaim();
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard guard(_write_lock);
+        Table * table = _table.load(std::memory_order_relaxed);
+        _table.store(new Table(table->bucket_count), std::memory_order_release);
+        _size.store(0, std::memory_order_relaxed);
+        _retired.retire(table);
+        _retired.reclaim();
+    }
+
+    size_type size() const noexcept {
+        //with concurrent writers this is only a snapshot
+        return _size.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    size_type bucket_count() const noexcept {
+        return _table.load(std::memory_order_acquire)->bucket_count;
+    }
+
+    size_type retired_count() {
+        //nodes and tables unlinked but not yet freed, because a reader that
+        //started before they were unlinked may still be running
+        std::lock_guard guard(_write_lock);
+        return _retired.size();
+    }
+};
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>  // std::max, std::min
+#include <bit>        // std::bit_ceil, std::countr_zero
+#include <cmath>      // std::ceil
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint64_t
+#include <cstring>    // std::memset
+#include <functional> // std::hash
+#include <memory>     // std::allocator
+#include <new>        // placement new
+#include <stdexcept>  // std::length_error
+#include <utility>    // std::pair
+#include <vector>
+
+/*
+    Open addressing hash map using Robin Hood linear probing, with the same
+    public surface as UnorderedMap.
+
+    Every slot stores its probe sequence length (how far it sits from its home
+    slot, plus one, 0 meaning empty). Inserts keep each run of slots sorted by
+    home slot, which means a lookup can stop as soon as it reaches a slot that
+    is closer to its own home than we are to ours. Erase shifts the rest of
+    the run back by one slot instead of leaving a tombstone, so long insert /
+    erase churn never degrades lookups.
+
+    Probing never wraps around: the slot array has an overflow area of
+    _max_distance slots past the last home slot, and a probe that would need
+    more than that grows the table instead.
+
+    A probe can't be longer than _longest_probe (254) slots, so no table
+    holds more than that many keys with the same home slot, and keys with
+    the same hash code always share it. Once the limit is reached, insert
+    grows the table at most _max_growths times looking for room and then
+    throws std::length_error rather than growing until memory runs out. A
+    hasher with that many collisions belongs in a chained map such as
+    UnorderedMap.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class RobinHoodMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using const_mapped_type = const T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    using slot_allocator = std::allocator<value_type>;
+
+    //longest probe sequence _distance can hold (its length + 1 must fit a byte)
+    static constexpr size_type _longest_probe = 254;
+    //times one insert may grow a table already at _longest_probe before it gives up
+    static constexpr unsigned _max_growths = 4;
+
+    size_type _capacity;     // number of home slots, a power of two
+    size_type _max_distance; // longest probe sequence we allow, at most _longest_probe
+    size_type _shift;        // 64 - log2(_capacity)
+    uint8_t * _distance;     // probe sequence length + 1 for every slot, 0 when empty
+    value_type * _slots;
+
+    size_type _size;
+    size_type _max_fill;
+
+    Hash _hash;
+    key_equal _equal;
+
+    float _max_load_factor;
+
+    size_type _slot_count() const {
+        return _capacity + _max_distance;
+    }
+
+    size_type _home(size_t code) const {
+        //the home slot is taken from the high bits of a Fibonacci multiply
+        //so weak hashes (e.g. identity for integers) still spread out
+        if(_capacity == 1) {
+            return 0;
+        }
+        return static_cast<size_type>((static_cast<uint64_t>(code) * 0x9E3779B97F4A7C15ull) >> _shift);
+    }
+
+    void _allocate(size_type capacity) {
+        //allocates an empty table with capacity home slots
+        _capacity = capacity;
+        _max_distance = std::min<size_type>(capacity, _longest_probe);
+        _shift = 64 - std::countr_zero(capacity);
+        //one extra always-empty entry ends every run before the end of the array
+        _distance = new uint8_t[_slot_count() + 1];
+        std::memset(_distance, 0, _slot_count() + 1);
+        _slots = slot_allocator().allocate(_slot_count());
+        _max_fill = static_cast<size_type>(capacity * static_cast<double>(_max_load_factor));
+    }
+
+    void _deallocate() {
+        slot_allocator().deallocate(_slots, _slot_count());
+        delete[] _distance;
+        _slots = nullptr;
+        _distance = nullptr;
+    }
+
+    void _destroy_values() {
+        for(size_type i = 0; i < _slot_count(); i++) {
+            if(_distance[i]) {
+                _slots[i].~value_type();
+            }
+        }
+    }
+
+    void _move_slot(size_type from, size_type to) {
+        //moves the value in slot from into the (empty) slot to
+        //the source is destroyed right after, so its key can be moved out from under the const
+        value_type & val = _slots[from];
+        new (_slots + to) value_type(std::move(const_cast<Key &>(val.first)), std::move(val.second));
+        val.~value_type();
+    }
+
+    size_type _find_index(size_t code, const Key & key) const {
+        //returns the slot holding key or _slot_count() if it is not in the map
+        //once we reach a slot that is closer to its home than we are to ours, the
+        //key would have been placed before it, so we can stop early
+        size_type index = _home(code);
+        for(size_type distance = 1; _distance[index] >= distance; index++, distance++) {
+            if(_distance[index] == distance && _equal(_slots[index].first, key)) {
+                return index;
+            }
+        }
+        return _slot_count();
+    }
+
+    bool _try_place(size_t code, size_type & placed) {
+        //finds where a new key with hash code belongs and makes room for it by
+        //shifting the rest of the run one slot to the right
+        //returns false without changing anything if that would push some element
+        //past _max_distance (the caller grows and tries again)
+
+        size_type index = _home(code);
+        size_type distance = 1;
+        while(_distance[index] >= distance) {
+            index++;
+            distance++;
+        }
+        if(distance > _max_distance) {
+            return false;
+        }
+
+        size_type empty = index;
+        while(_distance[empty]) {
+            if(_distance[empty] >= _max_distance) {
+                return false;
+            }
+            empty++;
+        }
+        if(empty == _slot_count()) {
+            return false;
+        }
+
+        for(size_type i = empty; i > index; i--) {
+            _move_slot(i - 1, i);
+            _distance[i] = _distance[i - 1] + 1;
+        }
+        _distance[index] = static_cast<uint8_t>(distance);
+        placed = index;
+        return true;
+    }
+
+    size_type _prepare_insert(size_t code) {
+        //returns an empty slot, already marked as used, for a new key with hash code
+        //the caller constructs the value there and then counts it in _size, or
+        //hands the slot back with _close_gap if constructing it throws
+        //throws std::length_error, leaving the map as it was apart from its
+        //capacity, if there is no room for it
+        if(_size + 1 > _max_fill) {
+            _resize(_capacity * 2);
+        }
+        size_type index;
+        unsigned growths = 0;
+        while(!_try_place(code, index)) {
+            //below _longest_probe home slots growing also allows longer probes,
+            //past that it only helps if the keys spread out
+            if(_max_distance == _longest_probe && growths++ == _max_growths) {
+                throw std::length_error("no room for the key in the RobinHoodMap, "
+                                        "too many keys share its home slot");
+            }
+            _resize(_capacity * 2);
+        }
+        return index;
+    }
+
+    void _resize(size_type capacity) {
+        //moves every value into a fresh table with capacity home slots
+        uint8_t * old_distance = _distance;
+        value_type * old_slots = _slots;
+        size_type old_count = _slot_count();
+
+        _allocate(capacity);
+
+        for(size_type i = 0; i < old_count; i++) {
+            if(old_distance[i]) {
+                //running out of room part way just grows the new table again
+                size_t code = _hash(old_slots[i].first);
+                size_type index;
+                while(!_try_place(code, index)) {
+                    _resize(_capacity * 2);
+                }
+                value_type & val = old_slots[i];
+                new (_slots + index) value_type(std::move(const_cast<Key &>(val.first)), std::move(val.second));
+                val.~value_type();
+            }
+        }
+
+        slot_allocator().deallocate(old_slots, old_count);
+        delete[] old_distance;
+    }
+
+    void _erase_index(size_type index) {
+        _slots[index].~value_type();
+        _size--;
+        _close_gap(index);
+    }
+
+    void _close_gap(size_type index) {
+        //backward shift deletion of the (already destroyed or never built) value
+        //in slot index: every following element of the run moves one slot closer
+        //to its home, then the last slot of the run becomes empty
+        while(_distance[index + 1] > 1) {
+            _move_slot(index + 1, index);
+            _distance[index] = _distance[index + 1] - 1;
+            index++;
+        }
+        _distance[index] = 0;
+    }
+
+    template <typename V>
+    std::pair<size_type, bool> _insert_unique(V && value) {
+        //same semantics as UnorderedMap::insert: if the key is already present
+        //its mapped value is overwritten
+        size_t code = _hash(value.first);
+        size_type index = _find_index(code, value.first);
+        if(index != _slot_count()) {
+            if(_slots[index].second != value.second) {
+                _slots[index].second = value.second;
+            }
+            return {index, false};
+        }
+        index = _prepare_insert(code);
+        try {
+            new (_slots + index) value_type(std::forward<V>(value));
+        } catch(...) {
+            _close_gap(index);
+            throw;
+        }
+        _size++;
+        return {index, true};
+    }
+
+    void _copy_from(const RobinHoodMap & other) {
+        //same layout as other, so every value can go into the same slot
+        _max_load_factor = other._max_load_factor;
+        _allocate(other._capacity);
+        std::memcpy(_distance, other._distance, _slot_count());
+        for(size_type i = 0; i < _slot_count(); i++) {
+            if(_distance[i]) {
+                new (_slots + i) value_type(other._slots[i]);
+            }
+        }
+        _size = other._size;
+    }
+
+    void _steal(RobinHoodMap & other) {
+        _capacity = other._capacity;
+        _max_distance = other._max_distance;
+        _shift = other._shift;
+        _distance = other._distance;
+        _slots = other._slots;
+        _size = other._size;
+        _max_fill = other._max_fill;
+        _max_load_factor = other._max_load_factor;
+
+        other._allocate(1);
+        other._size = 0;
+    }
+
+    public:
+
+    template <typename pointer_type, typename reference_type, typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class RobinHoodMap<Key, T, Hash, key_equal>;
+
+        const RobinHoodMap * _map;
+        size_type _index;
+
+        explicit basic_iterator(RobinHoodMap const * map, size_type index) noexcept {
+            _map = map;
+            _index = index;
+        }
+
+        void _skip_empty() {
+            while(_index < _map->_slot_count() && !_map->_distance[_index]) {
+                _index++;
+            }
+        }
+
+    public:
+        basic_iterator() {
+            _map = nullptr;
+            _index = 0;
+        };
+
+        basic_iterator(const basic_iterator &) = default;
+        basic_iterator(basic_iterator &&) = default;
+        ~basic_iterator() = default;
+        basic_iterator &operator=(const basic_iterator &) = default;
+        basic_iterator &operator=(basic_iterator &&) = default;
+        reference operator*() const {
+            return _map->_slots[_index];
+        }
+        pointer operator->() const {
+            return &(_map->_slots[_index]);
+        }
+        basic_iterator &operator++() {
+            //moves to the next used slot
+            _index++;
+            _skip_empty();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator copy = *this;
+            ++(*this);
+            return copy;
+        }
+        bool operator==(const basic_iterator &other) const noexcept {
+            return _index == other._index;
+        }
+        bool operator!=(const basic_iterator &other) const noexcept {
+            return _index != other._index;
+        }
+    };
+
+    using iterator = basic_iterator<pointer, reference, value_type>;
+    using const_iterator = basic_iterator<const_pointer, const_reference, const value_type>;
+
+    explicit RobinHoodMap(size_type bucket_count, const Hash & hash = Hash { },
+                const key_equal & equal = key_equal { }) : _hash(hash), _equal(equal) {
+        //bucket_count is rounded up to a power of two
+        _max_load_factor = 0.8f;
+        _allocate(std::bit_ceil(std::max<size_type>(bucket_count, 1)));
+        _size = 0;
+    }
+
+    ~RobinHoodMap() {
+        _destroy_values();
+        _deallocate();
+    }
+
+    RobinHoodMap(const RobinHoodMap & other) : _hash(other._hash), _equal(other._equal) {
+        _copy_from(other);
+    }
+
+    RobinHoodMap(RobinHoodMap && other) : _hash(other._hash), _equal(other._equal) {
+        _steal(other);
+    }
+
+    RobinHoodMap & operator=(const RobinHoodMap & other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = other._hash;
+            _equal = other._equal;
+            _copy_from(other);
+        }
+        return *this;
+    }
+
+    RobinHoodMap & operator=(RobinHoodMap && other) {
+        if(this != &other) {
+            _destroy_values();
+            _deallocate();
+            _hash = std::move(other._hash);
+            _equal = std::move(other._equal);
+            _steal(other);
+        }
+        return *this;
+    }
+
+    void clear() noexcept {
+        _destroy_values();
+        std::memset(_distance, 0, _slot_count());
+        _size = 0;
+    }
+
+    size_type size() const noexcept {
+        return _size;
+    }
+
+    bool empty() const noexcept {
+        return _size == 0;
+    }
+
+    iterator begin() {
+        iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    iterator end() {
+        return iterator(this, _slot_count());
+    }
+
+    const_iterator cbegin() const {
+        const_iterator start(this, 0);
+        start._skip_empty();
+        return start;
+    }
+    const_iterator cend() const {
+        return const_iterator(this, _slot_count());
+    }
+
+    //bucket statistics: every slot is a bucket holding at most one element,
+    //the overflow slots past the last home slot are counted as buckets too
+
+    size_type bucket_count() const noexcept {
+        return _slot_count();
+    }
+
+    size_type bucket_size(size_type n) const {
+        return _distance[n] ? 1 : 0;
+    }
+
+    size_type bucket(const Key & key) const {
+        //returns the home slot of key
+        return _home(_hash(key));
+    }
+
+    size_type probe_length(const Key & key) const {
+        //number of slots a successful lookup for key looks at (0 if it is not in the map)
+        size_type index = _find_index(_hash(key), key);
+        return index != _slot_count() ? _distance[index] : 0;
+    }
+
+    std::vector<size_type> probe_histogram() const {
+        //histogram[d] is the number of elements whose lookup looks at d + 1 slots
+        std::vector<size_type> histogram;
+        for(size_type i = 0; i < _slot_count(); i++) {
+            if(_distance[i]) {
+                if(histogram.size() < _distance[i]) {
+                    histogram.resize(_distance[i]);
+                }
+                histogram[_distance[i] - 1]++;
+            }
+        }
+        return histogram;
+    }
+
+    float load_factor() const {
+        return _size / static_cast<float>(_capacity);
+    }
+
+    float max_load_factor() const noexcept {
+        return _max_load_factor;
+    }
+
+    void max_load_factor(float ml) {
+        //sets the load factor we are allowed to reach before growing
+        //and grows right away if we are already past it
+        _max_load_factor = std::min(ml, 1.0f);
+        _max_fill = static_cast<size_type>(_capacity * static_cast<double>(_max_load_factor));
+        if(_size > _max_fill) {
+            reserve(_size);
+        }
+    }
+
+    void rehash(size_type count) {
+        //rebuilds the table with at least count home slots (and enough for our elements)
+        size_type needed = static_cast<size_type>(std::ceil(_size / static_cast<double>(_max_load_factor)));
+        _resize(std::bit_ceil(std::max<size_type>({count, needed, 1})));
+    }
+
+    void reserve(size_type count) {
+        //makes room for count elements without growing again
+        size_type needed = static_cast<size_type>(std::ceil(count / static_cast<double>(_max_load_factor)));
+        if(std::bit_ceil(std::max<size_type>(needed, 1)) > _capacity) {
+            _resize(std::bit_ceil(needed));
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        std::pair<size_type, bool> inserted = _insert_unique(std::move(value));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value) {
+        std::pair<size_type, bool> inserted = _insert_unique(value);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    iterator find(const Key & key) {
+        return iterator(this, _find_index(_hash(key), key));
+    }
+
+    T& operator[](const Key & key) {
+        size_t code = _hash(key);
+        size_type index = _find_index(code, key);
+        if(index == _slot_count()) {
+            index = _prepare_insert(code);
+            try {
+                new (_slots + index) value_type(key, T{});
+            } catch(...) {
+                _close_gap(index);
+                throw;
+            }
+            _size++;
+        }
+        return _slots[index].second;
+    }
+
+    iterator erase(iterator pos) {
+        //removes the element at pos and returns an iterator to the element after it
+        //the backward shift may pull a not yet visited element into pos itself
+        if(pos._index == _slot_count()) {
+            return pos;
+        }
+        _erase_index(pos._index);
+        pos._skip_empty();
+        return pos;
+    }
+
+    size_type erase(const Key & key) {
+        size_type index = _find_index(_hash(key), key);
+        if(index == _slot_count()) {
+            return 0;
+        }
+        _erase_index(index);
+        return 1;
+    }
+};
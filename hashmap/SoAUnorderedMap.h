@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>   // std::max, std::min
+#include <bit>         // std::bit_ceil, std::countr_zero
+#include <cmath>       // std::ceil
+#include <cstddef>     // size_t
+#include <cstdint>     // uint32_t, uint64_t
+#include <functional>  // std::hash
+#include <span>
+#include <stdexcept>   // std::length_error
+#include <type_traits> // std::conditional_t, std::is_invocable_v
+#include <utility>     // std::pair
+#include <vector>
+
+/*
+    Hash map that keeps its keys, mapped values and hash codes in three
+    separate dense arrays (struct of arrays), for workloads dominated by
+    scans over the values.
+
+        SoAUnorderedMap<std::string, int> counts(1024);
+        ...
+        long total = 0;
+        counts.for_each_value([&](int value) { total += value; });
+
+    Element i is keys()[i], values()[i] and hash_codes()[i]; there are no
+    gaps, so a scan over values() reads nothing but values, one cache line
+    after another, and a plain loop over it (sum, min/max, filter) can be
+    vectorized by the compiler. Iteration walks the same arrays in order.
+
+    Lookups go through a separate open addressing index of 8 byte slots
+    (element number + 1, 0 when empty, and the high half of the hash code to
+    skip most key comparisons), probed linearly from the slot picked by a
+    Fibonacci multiply of the hash code. Erasing moves the last element into
+    the hole so the arrays stay dense, and removes the index slot by
+    backward shifting, so there are no tombstones. Growing only rebuilds the
+    index, from the cached hash codes.
+
+    Inserting may reallocate the arrays and erasing moves the last element,
+    so both invalidate iterators, references and element numbers.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+class SoAUnorderedMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using const_mapped_type = const T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    struct Slot {
+        uint32_t element; // element number + 1, 0 when the slot is empty
+        uint32_t tag;     // the high half of the element's hash code
+    };
+
+    std::vector<Key> _keys;
+    std::vector<T> _values;
+    std::vector<size_t> _codes;
+
+    std::vector<Slot> _index; // a power of two number of slots
+    size_type _mask;
+    unsigned _shift;          // 64 - log2(_index.size())
+    size_type _max_fill;
+
+    Hash _hash;
+    key_equal _equal;
+
+    float _max_load_factor;
+
+    static uint32_t _tag(size_t code) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(code) >> 32);
+    }
+
+    size_type _home(size_t code) const {
+        //the high bits of a Fibonacci multiply, so weak hashes (e.g. identity
+        //for integers) still spread out
+        return static_cast<size_type>((static_cast<uint64_t>(code) * 0x9E3779B97F4A7C15ull) >> _shift);
+    }
+
+    size_type _find_slot(size_t code, const Key & key) const {
+        //returns the index slot of key, or _index.size() if it is not in the map
+        //at most _max_load_factor of the slots are used, so the probe ends
+        uint32_t tag = _tag(code);
+        for(size_type slot = _home(code);; slot = (slot + 1) & _mask) {
+            const Slot & s = _index[slot];
+            if(s.element == 0) {
+                return _index.size();
+            }
+            if(s.tag == tag && _equal(_keys[s.element - 1], key)) {
+                return slot;
+            }
+        }
+    }
+
+    size_type _slot_of(size_type element) const {
+        //returns the index slot pointing at element
+        for(size_type slot = _home(_codes[element]);; slot = (slot + 1) & _mask) {
+            if(_index[slot].element == element + 1) {
+                return slot;
+            }
+        }
+    }
+
+    void _place(size_type element) {
+        //points the first empty slot of element's probe sequence at it
+        size_type slot = _home(_codes[element]);
+        while(_index[slot].element) {
+            slot = (slot + 1) & _mask;
+        }
+        _index[slot] = { static_cast<uint32_t>(element + 1), _tag(_codes[element]) };
+    }
+
+    void _reindex(size_type capacity) {
+        //rebuilds the index with capacity slots (a power of two, at least 2)
+        _index.assign(capacity, Slot { 0, 0 });
+        _mask = capacity - 1;
+        _shift = 64 - std::countr_zero(capacity);
+        _max_fill = static_cast<size_type>(capacity * static_cast<double>(_max_load_factor));
+        for(size_type i = 0; i < _keys.size(); i++)
+            _place(i);
+    }
+
+    size_type _capacity_for(size_type count) const {
+        size_type needed = static_cast<size_type>(std::ceil(count / static_cast<double>(_max_load_factor))) + 1;
+        return std::bit_ceil(std::max<size_type>(needed, 2));
+    }
+
+    void _remove_slot(size_type hole) {
+        //backward shift deletion: every later slot of the run that may sit in
+        //the hole (its home is not between the hole and itself) moves into it
+        for(size_type next = (hole + 1) & _mask; _index[next].element; next = (next + 1) & _mask) {
+            size_type home = _home(_codes[_index[next].element - 1]);
+            if(((next - home) & _mask) >= ((next - hole) & _mask)) {
+                _index[hole] = _index[next];
+                hole = next;
+            }
+        }
+        _index[hole] = Slot { 0, 0 };
+    }
+
+    void _erase_element(size_type element) {
+        //moves the last element into element's place so the arrays stay dense
+        _remove_slot(_slot_of(element));
+        size_type last = _keys.size() - 1;
+        if(element != last) {
+            _index[_slot_of(last)].element = static_cast<uint32_t>(element + 1);
+            _keys[element] = std::move(_keys[last]);
+            _values[element] = std::move(_values[last]);
+            _codes[element] = _codes[last];
+        }
+        _keys.pop_back();
+        _values.pop_back();
+        _codes.pop_back();
+    }
+
+    template <typename K, typename M>
+    size_type _append(size_t code, K && key, M && value) {
+        //adds a new element at the end of the arrays and indexes it
+        size_type n = _keys.size();
+        if(n >= UINT32_MAX) {
+            throw std::length_error("SoAUnorderedMap holds at most 2^32 - 1 elements");
+        }
+        if(n + 1 > _max_fill) {
+            _reindex(_index.size() * 2);
+        }
+        try {
+            _codes.push_back(code);
+            _keys.push_back(std::forward<K>(key));
+            _values.push_back(std::forward<M>(value));
+        } catch(...) {
+            //leave the three arrays the same length
+            _codes.resize(n);
+            _keys.erase(_keys.begin() + n, _keys.end());
+            _values.erase(_values.begin() + n, _values.end());
+            throw;
+        }
+        _place(n);
+        return n;
+    }
+
+    template <typename V>
+    std::pair<size_type, bool> _insert_unique(V && value) {
+        //same semantics as UnorderedMap::insert: if the key is already present
+        //its mapped value is overwritten
+        size_t code = _hash(value.first);
+        size_type slot = _find_slot(code, value.first);
+        if(slot != _index.size()) {
+            size_type element = _index[slot].element - 1;
+            if(_values[element] != value.second) {
+                _values[element] = value.second;
+            }
+            return {element, false};
+        }
+        return {_append(code, std::forward<V>(value).first, std::forward<V>(value).second), true};
+    }
+
+    public:
+
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const Key, T>;
+        using difference_type = ptrdiff_t;
+        using reference = std::pair<const Key &, std::conditional_t<Const, const T &, T &>>;
+
+        //operator-> has to return something with an operator->, the pair is
+        //built on the fly from the two arrays
+        struct pointer {
+            reference _pair;
+            const reference * operator->() const {
+                return &_pair;
+            }
+        };
+
+    private:
+        friend class SoAUnorderedMap;
+
+        using map_pointer = std::conditional_t<Const, const SoAUnorderedMap *, SoAUnorderedMap *>;
+
+        map_pointer _map;
+        size_type _index;
+
+        explicit basic_iterator(map_pointer map, size_type index) noexcept : _map(map), _index(index) {}
+
+    public:
+        basic_iterator() : _map(nullptr), _index(0) {}
+
+        reference operator*() const {
+            return reference(_map->_keys[_index], _map->_values[_index]);
+        }
+        pointer operator->() const {
+            return pointer { **this };
+        }
+        size_type index() const noexcept {
+            //the element number, for the keys(), values() and hash_codes() arrays
+            return _index;
+        }
+        basic_iterator &operator++() {
+            _index++;
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator copy = *this;
+            _index++;
+            return copy;
+        }
+        bool operator==(const basic_iterator &other) const noexcept {
+            return _index == other._index;
+        }
+        bool operator!=(const basic_iterator &other) const noexcept {
+            return _index != other._index;
+        }
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    explicit SoAUnorderedMap(size_type bucket_count, const Hash & hash = Hash { },
+                             const key_equal & equal = key_equal { }) : _hash(hash), _equal(equal) {
+        //bucket_count is the number of index slots, rounded up to a power of two
+        _max_load_factor = 0.75f;
+        _reindex(std::bit_ceil(std::max<size_type>(bucket_count, 2)));
+    }
+
+    SoAUnorderedMap(const SoAUnorderedMap &) = default;
+    SoAUnorderedMap & operator=(const SoAUnorderedMap &) = default;
+
+    SoAUnorderedMap(SoAUnorderedMap && other)
+        : _keys(std::move(other._keys)), _values(std::move(other._values)), _codes(std::move(other._codes)),
+          _index(std::move(other._index)), _mask(other._mask), _shift(other._shift), _max_fill(other._max_fill),
+          _hash(other._hash), _equal(other._equal), _max_load_factor(other._max_load_factor) {
+        //other is left empty but usable
+        other.clear();
+        other._reindex(2);
+    }
+
+    SoAUnorderedMap & operator=(SoAUnorderedMap && other) {
+        if(this != &other) {
+            _keys = std::move(other._keys);
+            _values = std::move(other._values);
+            _codes = std::move(other._codes);
+            _index = std::move(other._index);
+            _mask = other._mask;
+            _shift = other._shift;
+            _max_fill = other._max_fill;
+            _hash = std::move(other._hash);
+            _equal = std::move(other._equal);
+            _max_load_factor = other._max_load_factor;
+            other.clear();
+            other._reindex(2);
+        }
+        return *this;
+    }
+
+    void clear() noexcept {
+        _keys.clear();
+        _values.clear();
+        _codes.clear();
+        std::fill(_index.begin(), _index.end(), Slot { 0, 0 });
+    }
+
+    size_type size() const noexcept {
+        return _keys.size();
+    }
+
+    bool empty() const noexcept {
+        return _keys.empty();
+    }
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+    iterator end() {
+        return iterator(this, _keys.size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+    const_iterator cend() const {
+        return const_iterator(this, _keys.size());
+    }
+
+    //the three parallel arrays, element i of each belongs together
+
+    std::span<const Key> keys() const noexcept {
+        return _keys;
+    }
+
+    std::span<T> values() noexcept {
+        return _values;
+    }
+    std::span<const T> values() const noexcept {
+        return _values;
+    }
+
+    std::span<const size_t> hash_codes() const noexcept {
+        return _codes;
+    }
+
+    template <typename F>
+    void for_each_value(F && f) {
+        //calls f(T &) or f(size_type i, T &) on every mapped value in element
+        //order, a straight loop over values() the compiler can vectorize
+        T * values = _values.data();
+        size_type n = _values.size();
+        if constexpr(std::is_invocable_v<F &, size_type, T &>) {
+            for(size_type i = 0; i < n; i++)
+                f(i, values[i]);
+        } else {
+            for(size_type i = 0; i < n; i++)
+                f(values[i]);
+        }
+    }
+
+    template <typename F>
+    void for_each_value(F && f) const {
+        const T * values = _values.data();
+        size_type n = _values.size();
+        if constexpr(std::is_invocable_v<F &, size_type, const T &>) {
+            for(size_type i = 0; i < n; i++)
+                f(i, values[i]);
+        } else {
+            for(size_type i = 0; i < n; i++)
+                f(values[i]);
+        }
+    }
+
+    //bucket statistics: every index slot is a bucket holding at most one element
+
+    size_type bucket_count() const noexcept {
+        return _index.size();
+    }
+
+    size_type bucket_size(size_type n) const {
+        return _index[n].element ? 1 : 0;
+    }
+
+    size_type bucket(const Key & key) const {
+        //returns the home slot of key
+        return _home(_hash(key));
+    }
+
+    float load_factor() const {
+        return size() / static_cast<float>(_index.size());
+    }
+
+    float max_load_factor() const noexcept {
+        return _max_load_factor;
+    }
+
+    void max_load_factor(float ml) {
+        //sets the load factor we are allowed to reach before growing
+        //and grows right away if we are already past it
+        _max_load_factor = std::min(ml, 0.95f);
+        _max_fill = static_cast<size_type>(_index.size() * static_cast<double>(_max_load_factor));
+        if(size() > _max_fill) {
+            _reindex(_capacity_for(size()));
+        }
+    }
+
+    void rehash(size_type count) {
+        //rebuilds the index with at least count slots (and enough for our elements)
+        _reindex(std::max(std::bit_ceil(std::max<size_type>(count, 2)), _capacity_for(size())));
+    }
+
+    void reserve(size_type count) {
+        //makes room for count elements without growing the arrays or the index again
+        _keys.reserve(count);
+        _values.reserve(count);
+        _codes.reserve(count);
+        if(_capacity_for(count) > _index.size()) {
+            _reindex(_capacity_for(count));
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        std::pair<size_type, bool> inserted = _insert_unique(std::move(value));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value) {
+        std::pair<size_type, bool> inserted = _insert_unique(value);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    iterator find(const Key & key) {
+        size_type slot = _find_slot(_hash(key), key);
+        return iterator(this, slot == _index.size() ? size() : _index[slot].element - 1);
+    }
+
+    const_iterator find(const Key & key) const {
+        size_type slot = _find_slot(_hash(key), key);
+        return const_iterator(this, slot == _index.size() ? size() : _index[slot].element - 1);
+    }
+
+    T& operator[](const Key & key) {
+        size_t code = _hash(key);
+        size_type slot = _find_slot(code, key);
+        if(slot != _index.size()) {
+            return _values[_index[slot].element - 1];
+        }
+        return _values[_append(code, key, T{})];
+    }
+
+    iterator erase(iterator pos) {
+        //removes the element at pos; the last element moves into its place,
+        //so the returned iterator is pos itself (end() if pos was the last)
+        if(pos._index == size()) {
+            return pos;
+        }
+        _erase_element(pos._index);
+        return pos;
+    }
+
+    size_type erase(const Key & key) {
+        size_type slot = _find_slot(_hash(key), key);
+        if(slot == _index.size()) {
+            return 0;
+        }
+        _erase_element(_index[slot].element - 1);
+        return 1;
+    }
+};
@@ -1,14 +1,101 @@
+#pragma once
+
+#include <algorithm>  // std::max
+#include <array>
+#include <atomic>
+#include <bit>        // std::countr_one
+#include <chrono>
+#include <cmath>      // std::ceil
+#include <concepts>   // std::convertible_to
 #include <cstddef>    // size_t
-#include <functional> // std::hash
+#include <cstdint>    // uint64_t
+#include <exception>  // std::exception_ptr
+#include <functional> // std::hash, std::less
 #include <ios>
-#include <utility>    // std::pair
+#include <iterator>   // std::iter_reference_t
+#include <memory>     // std::allocator, std::allocator_traits
+#include <optional>
+#include <ranges>     // std::ranges::begin, std::ranges::end
+#include <stdexcept>  // std::runtime_error
+#include <string_view>
+#include <thread>
+#include <tuple>      // std::forward_as_tuple
+#include <type_traits>
+#include <utility>    // std::pair, std::piecewise_construct, std::in_place
+#include <vector>
 #include <iostream>
 
-#include "primes.h"
+#include "bucket_policies.h"
+#include "snapshot.h"
+
+/*
+    What UnorderedMap::stats() reports. The shape of the table is measured on
+    the spot by walking every bucket, so it is always available:
+
+        successful_probes[k]    elements a find reaches after visiting k nodes
+                                (the k-th node of its chain)
+        unsuccessful_probes[k]  buckets where a find for a missing key visits
+                                k nodes (chains of length k)
+
+    The counters below them are collected as the map is used, and only when
+    UnorderedMap.h is compiled with UNORDERED_MAP_STATS defined. Without it
+    they are not there at all (counters_enabled is false and they read 0),
+    the map has no extra members and no operation does any extra work.
+*/
+struct hash_table_stats {
+    size_t size = 0;
+    size_t bucket_count = 0;
+    double load_factor = 0;
+
+    std::vector<size_t> successful_probes;
+    std::vector<size_t> unsuccessful_probes;
+    size_t longest_chain = 0;
+    //expected nodes visited by a find for a random element / a missing key
+    double average_successful_probes = 0;
+    double average_unsuccessful_probes = 0;
+    //variance of the chain lengths over all buckets, about load_factor for a
+    //good hash and much larger when keys pile into a few buckets
+    double chain_length_variance = 0;
+
+    //nodes and bucket arrays, not memory the keys and values allocate themselves
+    size_t bytes_allocated = 0;
+
+    bool counters_enabled = false;
+    size_t hash_calls = 0;
+    //keys compared with Pred, only done when the cached hash codes match,
+    //so anything well above the successful lookups means colliding codes
+    size_t key_comparisons = 0;
+    //times the bucket array was replaced (growth, rehash(), reseed())
+    size_t rehashes = 0;
+    std::chrono::nanoseconds rehash_time { 0 };
+};
 
 
 
-template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+//selects the parallel bulk build constructor of UnorderedMap
+struct parallel_build_t {
+    explicit parallel_build_t() = default;
+};
+inline constexpr parallel_build_t parallel_build { };
+
+/*
+    InlineCapacity > 0 turns on the small map mode: the map starts without a
+    bucket array and keeps its first InlineCapacity elements in nodes stored
+    inside the map object itself, on the same threaded node list as always.
+    A lookup is a walk down that list comparing keys, nothing is hashed and
+    nothing allocated. The insert that would go past InlineCapacity promotes
+    the map: the bucket array is allocated (at least the bucket_count given
+    to the constructor), every element is moved into a node of its own and
+    hashed, and from then on the map is the usual chained table. Iteration
+    order is kept, but like a rehash in std::unordered_map the promotion
+    invalidates iterators and references, and so does moving a small map
+    (its elements live in the object that is moved from).
+
+    A small map reports bucket_count() == 0 and load_factor() == 0.
+*/
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename Alloc = std::allocator<std::pair<const Key, T>>, typename RangePolicy = prime_modulo_policy,
+          size_t InlineCapacity = 0>
 class UnorderedMap {
     public:
 
@@ -17,6 +104,8 @@ class UnorderedMap {
     using const_mapped_type = const T;
     using hasher = Hash;
     using key_equal = Pred;
+    using allocator_type = Alloc;
+    using range_policy = RangePolicy;
     using value_type = std::pair<const key_type, mapped_type>;
     using reference = value_type &;
     using const_reference = const value_type &;
@@ -28,25 +117,163 @@ class UnorderedMap {
     private:
 
     struct HashNode {
+        //next links the nodes of one bucket
+        //list_prev/list_next thread every node of the map into one list for iteration
         HashNode *next;
+        HashNode *list_prev;
+        HashNode *list_next;
+        //the key's hash code, computed once on insert
+        size_t hash;
         value_type val;
 
-        HashNode(HashNode *next = nullptr) : next{next} {}
-        HashNode(const value_type & val, HashNode * next = nullptr) : next { next }, val { val } { }
-        HashNode(value_type && val, HashNode * next = nullptr) : next { next }, val { std::move(val) } { }
+        HashNode(HashNode *next = nullptr) : next{next}, list_prev{nullptr}, list_next{nullptr}, hash{0} {}
+        HashNode(const value_type & val, HashNode * next = nullptr)
+            : next { next }, list_prev { nullptr }, list_next { nullptr }, hash { 0 }, val { val } { }
+        HashNode(value_type && val, HashNode * next = nullptr)
+            : next { next }, list_prev { nullptr }, list_next { nullptr }, hash { 0 }, val { std::move(val) } { }
+        //constructs val in place from args
+        template <typename... Args>
+        explicit HashNode(std::in_place_t, Args &&... args)
+            : next { nullptr }, list_prev { nullptr }, list_next { nullptr }, hash { 0 }, val(std::forward<Args>(args)...) { }
     };
 
     size_type _bucket_count;
     HashNode **_buckets;
 
+    //while an incremental rehash is in progress the previous bucket array is kept
+    //here and drained a few buckets at a time
+    //every old bucket below _migrated has already been moved into _buckets
+    size_type _old_bucket_count;
+    HashNode **_old_buckets;
+    size_type _migrated;
+
+    //reduce hash codes to indices of _buckets and _old_buckets (see bucket_policies.h)
+    RangePolicy _range;
+    RangePolicy _old_range;
+
+    //nodes are allocated through Alloc rebound to HashNode
+    using node_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<HashNode>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    node_allocator _node_alloc;
+
+    //first and last node of the threaded node list, in insertion order
     HashNode * _head;
+    HashNode * _tail;
     size_type _size;
 
     Hash _hash;
     key_equal _equal;
 
-    static size_type _range_hash(size_type hash_code, size_type bucket_count) {
-        return hash_code % bucket_count;
+    float _max_load_factor;
+
+    bool _incremental;
+    size_type _rehash_step;
+
+    //with a transparent hasher and key_equal (both declare is_transparent) the
+    //lookup functions also accept anything the two can handle, e.g. a
+    //std::string_view or const char * for std::string keys, without building a Key
+    static constexpr bool _transparent = requires {
+        typename Hash::is_transparent;
+        typename Pred::is_transparent;
+    };
+
+    //a hasher with reseed() (siphash13, seeded_wyhash) gets a new seed, and every
+    //key a new hash code, when an insert lands in a chain this much longer than
+    //max_load_factor lets the average one be (see _check_chain)
+    static constexpr bool _reseedable = requires(Hash & hash) { hash.reseed(); };
+    static constexpr double _long_chain_factor = 8.0;
+    static constexpr size_type _long_chain_minimum = 32;
+
+    //the bucket count at the last reseed, we reseed at most once per bucket
+    //count so a hasher the seed can't help (or keys that are equal under Pred
+    //but were never meant to be) never turns every insert into a full rehash
+    size_type _reseeded_at;
+
+    //find_batch and insert_batch hash and prefetch this many keys at a time
+    static constexpr size_type _batch_size = 32;
+
+    //storage for the nodes of a small map, the union keeps the node from being
+    //constructed until a slot is actually used
+    //_inline_used has bit i set while _inline[i] holds a node
+    //without inline slots both take no space
+    static_assert(InlineCapacity <= 64, "the inline slots are tracked in a 64-bit mask");
+    union InlineSlot {
+        HashNode node;
+        InlineSlot() { }
+        ~InlineSlot() { }
+    };
+    [[no_unique_address]] std::array<InlineSlot, InlineCapacity> _inline;
+    [[no_unique_address]] std::conditional_t<(InlineCapacity > 0), uint64_t, std::tuple<>> _inline_used { };
+
+#ifdef UNORDERED_MAP_STATS
+    //the counters of hash_table_stats, mutable since const lookups count too
+    //and atomic since const lookups may run on several threads at once (the
+    //readers of a ConcurrentUnorderedMap do); relaxed, they order nothing
+    struct Counters {
+        std::atomic<size_t> hash_calls = 0;
+        std::atomic<size_t> key_comparisons = 0;
+        std::atomic<size_t> rehashes = 0;
+        std::atomic<std::chrono::nanoseconds::rep> rehash_time = 0;
+
+        void reset() noexcept {
+            hash_calls.store(0, std::memory_order_relaxed);
+            key_comparisons.store(0, std::memory_order_relaxed);
+            rehashes.store(0, std::memory_order_relaxed);
+            rehash_time.store(0, std::memory_order_relaxed);
+        }
+    };
+    mutable Counters _counters;
+#endif
+
+    //the helpers below compile to nothing without UNORDERED_MAP_STATS
+
+    template <typename K>
+    size_t _hash_code(const K & key) const {
+        _count_hashes(1);
+        return _hash(key);
+    }
+
+    void _count_hashes(size_type count) const {
+#ifdef UNORDERED_MAP_STATS
+        _counters.hash_calls.fetch_add(count, std::memory_order_relaxed);
+#else
+        (void)count;
+#endif
+    }
+
+    void _count_comparison() const {
+#ifdef UNORDERED_MAP_STATS
+        _counters.key_comparisons.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    //counts one rehash on construction and adds the time until it goes out of scope
+    struct RehashTimer {
+#ifdef UNORDERED_MAP_STATS
+        const UnorderedMap * _map;
+        std::chrono::steady_clock::time_point _start;
+
+        explicit RehashTimer(const UnorderedMap * map, bool count = true)
+            : _map(map), _start(std::chrono::steady_clock::now()) {
+            _map->_counters.rehashes.fetch_add(count, std::memory_order_relaxed);
+        }
+        ~RehashTimer() {
+            std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - _start;
+            _map->_counters.rehash_time.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        }
+#else
+        explicit RehashTimer(const UnorderedMap *, bool = true) { }
+#endif
+    };
+
+    static void _prefetch(const void * address) {
+        //hints the cpu to start loading address into cache, a no-op where unsupported
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
     }
 
     public:
@@ -61,8 +288,8 @@ class UnorderedMap {
         using reference = value_type &;
 
     private:
-        friend class UnorderedMap<Key, T, Hash, key_equal>;
-        using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+        friend class UnorderedMap;
+        using HashNode = typename UnorderedMap::HashNode;
 
         const UnorderedMap * _map;
         HashNode * _ptr;
@@ -91,39 +318,14 @@ class UnorderedMap {
         }
         basic_iterator &operator++() {
             //changes _ptr to the next node in the unordered map
-            //even if that node is in another bucket
-            //we want to first check if the next node is nullptr
-            //if yes, then our next node is in the next bucket
-            //we can find that bucket using the _bucket method
-
-            if(_ptr->next) {
-                _ptr = _ptr->next;
-                return *this;
-            }
-            size_t bucket_index = _map->_bucket(_ptr->val) + 1;
-            while(bucket_index < (_map->_bucket_count) && !(_map->_buckets[bucket_index])){
-                bucket_index++;
-            }
-            if(bucket_index >= _map->_bucket_count)
-                _ptr = nullptr;
-            else
-                _ptr = _map->_buckets[bucket_index];
+            //every node is threaded into one list so we never have to look at
+            //the buckets (or rehash the key) to find it
+            _ptr = _ptr->list_next;
             return *this;
         }
         basic_iterator operator++(int) {
             basic_iterator copy = *this;
-            if(_ptr->next) {
-                _ptr = _ptr->next;
-                return copy;
-            }
-            size_t bucket_index = _map->_bucket(_ptr->val) + 1;
-            while(bucket_index < (_map->_bucket_count) && !(_map->_buckets[bucket_index])){
-                bucket_index++;
-            }
-            if(bucket_index >= _map->_bucket_count)
-                _ptr = nullptr;
-            else
-                _ptr = _map->_buckets[bucket_index];
+            ++(*this);
             return copy;
 
         }
@@ -138,6 +340,90 @@ class UnorderedMap {
     using iterator = basic_iterator<pointer, reference, value_type>;
     using const_iterator = basic_iterator<const_pointer, const_reference, const value_type>;
 
+    //owns one element taken out of a map by extract, which insert can link
+    //into another map (or back into this one) without copying or allocating
+    //an empty handle holds nothing, a non-empty one that is never inserted
+    //destroys its element when it goes away
+    //unlike std::unordered_map's node handles the key can't be changed
+    class node_type {
+        friend class UnorderedMap;
+
+        HashNode * _node = nullptr;
+        //engaged exactly when _node is set
+        std::optional<node_allocator> _alloc;
+
+        node_type(HashNode * node, const node_allocator & alloc) : _node(node), _alloc(alloc) { }
+
+        HashNode * _release() noexcept {
+            _alloc.reset();
+            return std::exchange(_node, nullptr);
+        }
+
+        void _destroy() noexcept {
+            if(_node) {
+                node_traits::destroy(*_alloc, _node);
+                node_traits::deallocate(*_alloc, _node, 1);
+            }
+            _release();
+        }
+
+        public:
+
+        using key_type = Key;
+        using mapped_type = T;
+        using allocator_type = Alloc;
+
+        node_type() = default;
+        node_type(const node_type &) = delete;
+        node_type & operator=(const node_type &) = delete;
+
+        node_type(node_type && other) noexcept : _node(other._node), _alloc(std::move(other._alloc)) {
+            other._release();
+        }
+
+        node_type & operator=(node_type && other) noexcept {
+            if(this != &other) {
+                _destroy();
+                _node = other._node;
+                _alloc = std::move(other._alloc);
+                other._release();
+            }
+            return *this;
+        }
+
+        ~node_type() {
+            _destroy();
+        }
+
+        bool empty() const noexcept {
+            return _node == nullptr;
+        }
+
+        explicit operator bool() const noexcept {
+            return _node != nullptr;
+        }
+
+        const key_type & key() const {
+            return (_node->val).first;
+        }
+
+        mapped_type & mapped() const {
+            return (_node->val).second;
+        }
+
+        allocator_type get_allocator() const {
+            return allocator_type(*_alloc);
+        }
+    };
+
+    //what insert(node_type &&) returns: where the key is in the map, whether
+    //the handle's element was linked in, and if it wasn't the handle itself
+    struct insert_return_type {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
     class local_iterator {
         public:
             using iterator_category = std::forward_iterator_tag;
@@ -147,8 +433,8 @@ class UnorderedMap {
             using reference = value_type &;
 
         private:
-            friend class UnorderedMap<Key, T, Hash, key_equal>;
-            using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+            friend class UnorderedMap;
+            using HashNode = typename UnorderedMap::HashNode;
 
             HashNode * _node;
 
@@ -194,15 +480,47 @@ class UnorderedMap {
 
 private:
 
-    size_type _bucket(size_t code) const { 
-        //returns the index of the bucket for hash code
-        return _range_hash(code, _bucket_count);
+    bool _small() const noexcept {
+        //true while the map has no bucket array (see the comment above the class)
+        if constexpr (InlineCapacity > 0) {
+            return _buckets == nullptr;
+        } else {
+            return false;
+        }
+    }
+
+    bool _is_inline(const HashNode * node) const noexcept {
+        if constexpr (InlineCapacity > 0) {
+            const HashNode * first = &_inline[0].node;
+            return !std::less<const HashNode *>()(node, first) && std::less<const HashNode *>()(node, first + InlineCapacity);
+        } else {
+            return false;
+        }
+    }
+
+    template <typename K>
+    HashNode* _find_small(const K & key) const {
+        //a small map is searched by comparing key with every element in turn
+        for(HashNode* curr = _head; curr; curr = curr->list_next) {
+            _count_comparison();
+            if(_equal((curr->val).first, key)) {
+                return curr;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename K>
+    size_t _code_for(const K & key) const {
+        //the hash code of key, or 0 for a small map which doesn't hash at all
+        return _small() ? 0 : _hash_code(key);
     }
+
     size_type _bucket(const Key & key) const {
-        //hashes a given key then returns the index of the bucket containing the value 
+        //hashes a given key then returns the index of the bucket containing the value
         //associated with a given key
-        size_t code = _hash(key);
-        return _bucket(code);
+        size_t code = _hash_code(key);
+        return _range.index(code);
     }
     size_type _bucket(const value_type & val) const {
         //hashes the key in the pair
@@ -210,75 +528,773 @@ private:
         return _bucket(val.first);
     }
 
-    HashNode*& _find(size_type code, size_type bucket, const Key & key) {
-        //traverses bucket for given hash code
+    //positions number every bucket: the current bucket array comes first
+    //(0 .. _bucket_count - 1) followed by the old array while an incremental
+    //rehash is running (_bucket_count + old index)
+
+    size_type _position(size_t code) const {
+        //returns the position of the bucket holding hash code
+        //a key whose old bucket has not been migrated yet still lives in the old array
+        if(_old_buckets) {
+            size_type old_bucket = _old_range.index(code);
+            if(old_bucket >= _migrated) {
+                return _bucket_count + old_bucket;
+            }
+        }
+        return _range.index(code);
+    }
+
+    size_type _end_position() const {
+        return _bucket_count + (_old_buckets ? _old_bucket_count : 0);
+    }
+
+    HashNode*& _slot(size_type position) const {
+        //returns the bucket head stored at position
+        if(position < _bucket_count) {
+            return _buckets[position];
+        }
+        return _old_buckets[position - _bucket_count];
+    }
+
+    template <typename K>
+    HashNode* _find(size_type code, const K & key) const {
+        //traverses the bucket for given hash code
         //returns node with given key if it exists
         //otherwise returns nullptr
+        if(_small()) {
+            return _find_small(key);
+        }
+        return _find_at(_position(code), code, key);
+    }
 
-        HashNode* curr = _buckets[bucket];
+    template <typename K>
+    HashNode* _find_at(size_type position, size_t code, const K & key) const {
+        //same as above with the bucket position of code already known
+        if(_small()) {
+            return _find_small(key);
+        }
+        HashNode* curr = _slot(position);
 
         while(curr) {
-            if((curr->val).first == key) {
-                return curr;
+            //the cached hash codes rule out most other keys without comparing them
+            if(curr->hash == code) {
+                _count_comparison();
+                if(_equal((curr->val).first, key)) {
+                    return curr;
+                }
             }
             curr = curr->next;
         }
         return nullptr;
     }
 
-    HashNode*& _find(const Key & key) {
-        //same as above but we need to calculate the hash code, and the bucket index
-        size_type code = _hash(key);
-        size_type bucket = _bucket(code);
-        return _find(code, bucket, key);
+    template <typename K>
+    HashNode* _find(const K & key) const {
+        //same as above but we need to calculate the hash code
+        if(_small()) {
+            return _find_small(key);
+        }
+        return _find(_hash_code(key), key);
     }
 
-    HashNode * _insert_into_bucket(size_type bucket, value_type && value) {
-        //the global _head HashNode pointer should point to the first populated
-        //bucket in our HashNode
+    template <typename It, typename Sentinel, typename Project, typename Resolve>
+    void _batched(It first, Sentinel last, Project key_of, Resolve resolve) {
+        //calls resolve(position, code, element) for every element in [first, last),
+        //in order, with code the hash of key_of(element) and position its bucket
+        //elements are handled _batch_size at a time: the first pass hashes the
+        //group and prefetches every bucket slot, the second reads the (by now
+        //cached) slots and prefetches the first node of each chain, and only then
+        //are the chains walked, so the cache misses of a whole group overlap
+        //instead of queueing up one after the other
+        //a hasher with hash_batch (see hash_functions.h) hashes the whole group in
+        //one call, as long as the keys are strings that outlive the call
+        using key_reference = std::invoke_result_t<Project &, std::iter_reference_t<It>>;
+        constexpr bool hash_batch = std::is_lvalue_reference_v<std::iter_reference_t<It>>
+            && std::is_convertible_v<key_reference, std::string_view>
+            && requires(const Hash & hash, const std::string_view * keys, size_t * out) {
+                hash.hash_batch(keys, size_type { }, out);
+            };
+
+        size_t codes[_batch_size];
+        size_type positions[_batch_size];
+
+        while(first != last) {
+            if(_small()) {
+                //nothing to hash or prefetch, resolve ignores position and code
+                resolve(0, 0, *first);
+                ++first;
+                continue;
+            }
 
-        //everytime we insert node into a given bucket, we also want to check the indexes
-        //of the buckets, if the curr bucket has an index less than or eq to _head's bucket
-        //then set head to this bucket
-        
-        //algorithm:
-        //1. get bucket that our _head points to using the private _bucket() helper fn
-        //2. create new HashNode on the heap using given value
-        //3. set bucket's new head to that HashNode
-        //4. compare _head bucket and curr bucket and reassign accordingly
+            //every group pays for one step of a pending incremental rehash
+            _rehash_step_if_needed();
 
-        size_type head_bucket = 0;
-        bool exists = false;
-        HashNode* newNode;
-        
-        if(_head) {
-            head_bucket = _bucket(_head->val);
+            size_type count = 0;
+            if constexpr (hash_batch) {
+                std::string_view keys[_batch_size];
+                for(It it = first; it != last && count < _batch_size; ++it, count++) {
+                    keys[count] = key_of(*it);
+                }
+                _hash.hash_batch(keys, count, codes);
+                _count_hashes(count);
+            } else {
+                for(It it = first; it != last && count < _batch_size; ++it, count++) {
+                    codes[count] = _hash_code(key_of(*it));
+                }
+            }
+            for(size_type i = 0; i < count; i++) {
+                positions[i] = _position(codes[i]);
+                _prefetch(&_slot(positions[i]));
+            }
+            for(size_type i = 0; i < count; i++) {
+                if(HashNode* head = _slot(positions[i])) {
+                    _prefetch(head);
+                }
+            }
+
+            HashNode** buckets = _buckets;
+            for(size_type i = 0; i < count; i++, ++first) {
+                if(buckets != _buckets) {
+                    //resolve grew the table (or reseeded the hasher, which also
+                    //changes the codes), the remaining positions are stale
+                    buckets = _buckets;
+                    It it = first;
+                    for(size_type j = i; j < count; j++, ++it) {
+                        if constexpr (_reseedable) {
+                            codes[j] = _hash_code(key_of(*it));
+                        }
+                        positions[j] = _position(codes[j]);
+                    }
+                }
+                resolve(positions[i], codes[i], *first);
+            }
         }
+    }
 
-        HashNode* curr = _buckets[bucket];
-        while(curr) {
-            if((curr->val).first == value.first) {
-                exists = true;
-                newNode = curr;
-                if((curr->val).second != value.second) {
-                    (curr->val).second = value.second;
+    template <typename F>
+    static void _run_parallel(size_type threads, F && body) {
+        //runs body(0) .. body(threads - 1) at once, the last on the calling
+        //thread, and rethrows the first exception any of them threw
+        std::vector<std::exception_ptr> errors(threads);
+        auto guarded = [&](size_type t) {
+            try {
+                body(t);
+            } catch(...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        try {
+            for(size_type t = 0; t + 1 < threads; t++) {
+                workers.emplace_back(guarded, t);
+            }
+        } catch(...) {
+            //no thread for the rest of the work, do it here
+            for(size_type t = workers.size(); t + 1 < threads; t++) {
+                guarded(t);
+            }
+        }
+        guarded(threads - 1);
+        for(std::thread & worker : workers) {
+            worker.join();
+        }
+        for(std::exception_ptr & error : errors) {
+            if(error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    template <typename Values>
+    void _build_parallel(const Values & values, size_type threads) {
+        //fills the (empty, bucketed) map with values, see the constructor
+        //the work is split by bucket: partition p owns the buckets
+        //[p * part_buckets, (p + 1) * part_buckets) and is built by thread p alone
+        size_type n = std::ranges::size(values);
+        auto first = std::ranges::begin(values);
+
+        //thread t hashes input chunk [t * n / threads, (t + 1) * n / threads)
+        //counts[t * threads + p] is how many of those fall in partition p
+        std::vector<size_t> codes(n);
+        std::vector<size_type> counts(threads * threads, 0);
+        size_type part_buckets = (_bucket_count + threads - 1) / threads;
+        auto chunk = [&](size_type t) { return std::pair(t * n / threads, (t + 1) * n / threads); };
+        _run_parallel(threads, [&](size_type t) {
+            auto [begin, end] = chunk(t);
+            for(size_type i = begin; i < end; i++) {
+                codes[i] = _hash(first[i].first);
+                counts[t * threads + _range.index(codes[i]) / part_buckets]++;
+            }
+        });
+        _count_hashes(n);
+
+        //scatter the element numbers so every partition's are contiguous, in input order
+        std::vector<size_type> starts(threads + 1, 0);
+        size_type offset = 0;
+        for(size_type p = 0; p < threads; p++) {
+            starts[p] = offset;
+            for(size_type t = 0; t < threads; t++) {
+                size_type count = counts[t * threads + p];
+                counts[t * threads + p] = offset;
+                offset += count;
+            }
+        }
+        starts[threads] = n;
+        std::vector<size_type> order(n);
+        _run_parallel(threads, [&](size_type t) {
+            auto [begin, end] = chunk(t);
+            for(size_type i = begin; i < end; i++) {
+                order[counts[t * threads + _range.index(codes[i]) / part_buckets]++] = i;
+            }
+        });
+
+        //every thread allocates through an allocator of its own: a PoolAllocator
+        //(anything with adopt) gets a fresh pool whose chunks are handed to ours
+        //at the end, std::allocator style ones (always equal) a plain copy
+        struct Part {
+            node_allocator alloc;
+            HashNode * head = nullptr;
+            HashNode * tail = nullptr;
+            size_type size = 0;
+        };
+        constexpr bool adoptable = requires(node_allocator & a) { a.adopt(a); };
+        std::vector<Part> parts;
+        parts.reserve(threads);
+        for(size_type p = 0; p < threads; p++) {
+            if constexpr (adoptable) {
+                parts.push_back(Part { node_traits::select_on_container_copy_construction(_node_alloc) });
+            } else {
+                parts.push_back(Part { _node_alloc });
+            }
+        }
+
+        std::exception_ptr error;
+        try {
+            _run_parallel(threads, [&](size_type p) {
+                Part & part = parts[p];
+                for(size_type k = starts[p]; k < starts[p + 1]; k++) {
+                    size_type i = order[k];
+                    const auto & value = first[i];
+                    HashNode*& bucket = _buckets[_range.index(codes[i])];
+                    HashNode* curr = bucket;
+                    while(curr && !(curr->hash == codes[i] && _equal((curr->val).first, value.first))) {
+                        curr = curr->next;
+                    }
+                    if(curr) {
+                        //a repeated key keeps its first position and its last value, as with insert
+                        (curr->val).second = value.second;
+                        continue;
+                    }
+                    HashNode* node = node_traits::allocate(part.alloc, 1);
+                    try {
+                        node_traits::construct(part.alloc, node, std::in_place, value.first, value.second);
+                    } catch(...) {
+                        node_traits::deallocate(part.alloc, node, 1);
+                        throw;
+                    }
+                    node->hash = codes[i];
+                    node->next = bucket;
+                    bucket = node;
+                    node->list_prev = part.tail;
+                    (part.tail ? part.tail->list_next : part.head) = node;
+                    part.tail = node;
+                    part.size++;
                 }
-                break;
+            });
+        } catch(...) {
+            error = std::current_exception();
+        }
+
+        //the partitions' lists are joined in partition order, nodes built before
+        //an exception are on them too and go away with clear()
+        for(Part & part : parts) {
+            if(!part.head) {
+                continue;
             }
-            curr = curr->next;
+            part.head->list_prev = _tail;
+            (_tail ? _tail->list_next : _head) = part.head;
+            _tail = part.tail;
+            _size += part.size;
+            if constexpr (adoptable) {
+                _node_alloc.adopt(part.alloc);
+            }
+        }
+        if(error) {
+            std::rethrow_exception(error);
         }
-        if(!exists) {
-            newNode = new HashNode(std::move(value), _buckets[bucket]);
-            _buckets[bucket] = newNode;
+    }
+
+    size_type _min_buckets_for(size_type count) const {
+        //smallest bucket count that keeps count elements within max_load_factor
+        return static_cast<size_type>(std::ceil(count / static_cast<double>(_max_load_factor)));
+    }
+
+    void _start_rehash(size_type count) {
+        //swaps in an empty bucket array of count buckets and keeps the current one
+        //around as the old array, the nodes are then moved over by _migrate
+        RehashTimer timer(this);
+        _old_buckets = _buckets;
+        _old_bucket_count = _bucket_count;
+        _old_range = _range;
+        _migrated = 0;
+        _buckets = new HashNode*[count]{};
+        _bucket_count = count;
+        _range.reset(count);
+    }
+
+    void _migrate(size_type buckets) {
+        //moves up to buckets populated buckets out of the old array into the new one
+        //visiting at most ten times as many empty buckets so a single call stays cheap
+        //once the old array has been drained it is released
+
+        if(!_old_buckets) {
+            return;
+        }
+
+        //the time goes to the rehash _start_rehash already counted
+        RehashTimer timer(this, false);
+        size_type moved = 0;
+        size_type visited = 0;
+
+        while(_migrated < _old_bucket_count && moved < buckets && visited < buckets * 10) {
+            HashNode* curr = _old_buckets[_migrated];
+            _old_buckets[_migrated] = nullptr;
+            _migrated++;
+            visited++;
+            if(curr) {
+                moved++;
+            }
+            while(curr) {
+                HashNode* next = curr->next;
+                size_type index = _range.index(curr->hash);
+                curr->next = _buckets[index];
+                _buckets[index] = curr;
+                curr = next;
+            }
+        }
+
+        if(_migrated == _old_bucket_count) {
+            delete[] _old_buckets;
+            _old_buckets = nullptr;
+            _old_bucket_count = 0;
+            _migrated = 0;
+        }
+    }
+
+    void _finish_rehash() {
+        //drains whatever is left of an incremental rehash in one go
+        while(_old_buckets) {
+            _migrate(_old_bucket_count);
+        }
+    }
+
+    void _rehash_step_if_needed() {
+        //every insert/find/erase pays for a small slice of a pending rehash
+        if(_old_buckets) {
+            _migrate(_rehash_step);
+        }
+    }
+
+    bool _grow_for_insert() {
+        //called right before a new node is linked in
+        //if one more element would push us past max_load_factor we move up to
+        //the RangePolicy's next bucket count (about twice as many buckets with
+        //the default policies, see bucket_policies.h)
+        //in incremental mode we only swap in the new array here and let later
+        //operations move the nodes over
+        //returns true if the buckets were changed (so positions must be recomputed)
+        if(_size + 1 <= _bucket_count * static_cast<double>(_max_load_factor)) {
+            return false;
+        }
+        size_type count = std::max(_bucket_count + 1, _min_buckets_for(_size + 1));
+        if(_incremental) {
+            _finish_rehash();
+            _start_rehash(RangePolicy::bucket_count_for(count));
+        } else {
+            rehash(count);
+        }
+        return true;
+    }
+
+    template <typename... Args>
+    HashNode * _new_node(Args &&... args) {
+        //allocates and constructs a node through the node allocator
+        //a small map with a free inline slot constructs it there instead
+        if constexpr (InlineCapacity > 0) {
+            size_type slot = std::countr_one(_inline_used);
+            if(_small() && slot < InlineCapacity) {
+                HashNode* node = &_inline[slot].node;
+                node_traits::construct(_node_alloc, node, std::forward<Args>(args)...);
+                _inline_used |= uint64_t(1) << slot;
+                return node;
+            }
+        }
+        HashNode* node = node_traits::allocate(_node_alloc, 1);
+        try {
+            node_traits::construct(_node_alloc, node, std::forward<Args>(args)...);
+        } catch(...) {
+            node_traits::deallocate(_node_alloc, node, 1);
+            throw;
+        }
+        return node;
+    }
+
+    void _delete_node(HashNode * node) {
+        node_traits::destroy(_node_alloc, node);
+        if constexpr (InlineCapacity > 0) {
+            if(_is_inline(node)) {
+                _inline_used &= ~(uint64_t(1) << (reinterpret_cast<InlineSlot *>(node) - _inline.data()));
+                return;
+            }
+        }
+        node_traits::deallocate(_node_alloc, node, 1);
+    }
+
+    void _promote() {
+        //turns a small map into a chained table: allocates the bucket array,
+        //moves every element into a heap node of its own and hashes it
+        //the new nodes are all built before anything is changed, so if that
+        //throws the map is still small (with the elements moved so far moved from)
+        RehashTimer timer(this);
+        size_type count = RangePolicy::bucket_count_for(std::max(_bucket_count, _min_buckets_for(_size + 1)));
+        HashNode* nodes[InlineCapacity > 0 ? InlineCapacity : 1];
+        size_type built = 0;
+        HashNode** buckets = nullptr;
+        try {
+            for(HashNode* curr = _head; curr; curr = curr->list_next) {
+                HashNode* node = node_traits::allocate(_node_alloc, 1);
+                try {
+                    node_traits::construct(_node_alloc, node, std::move(curr->val));
+                } catch(...) {
+                    node_traits::deallocate(_node_alloc, node, 1);
+                    throw;
+                }
+                nodes[built++] = node;
+                node->hash = _hash_code((node->val).first);
+            }
+            buckets = new HashNode*[count]{};
+        } catch(...) {
+            for(size_type i = 0; i < built; i++) {
+                node_traits::destroy(_node_alloc, nodes[i]);
+                node_traits::deallocate(_node_alloc, nodes[i], 1);
+            }
+            throw;
+        }
+
+        for(HashNode* curr = _head; curr; ) {
+            HashNode* next = curr->list_next;
+            _delete_node(curr);
+            curr = next;
+        }
+        _head = nullptr;
+        _tail = nullptr;
+        _buckets = buckets;
+        _bucket_count = count;
+        _range.reset(count);
+        for(size_type i = 0; i < built; i++) {
+            size_type index = _range.index(nodes[i]->hash);
+            nodes[i]->next = _buckets[index];
+            _buckets[index] = nodes[i];
+            _append_to_list(nodes[i]);
+        }
+    }
+
+    void _take_inline_nodes(UnorderedMap & other) {
+        //moving a small map can't just take its inline nodes, they live inside
+        //other, so their elements are moved into our slots and other is cleared
+        //a small map can also hold heap nodes (relinked by insert(node_type) or
+        //merge); those came from the allocator we just took over, so they are
+        //relinked as they are, other's new allocator must never free them
+        _head = nullptr;
+        _tail = nullptr;
+        _size = 0;
+        for(HashNode* curr = other._head; curr; ) {
+            HashNode* next = curr->list_next;
+            if(other._is_inline(curr)) {
+                _append_to_list(_new_node(std::move(curr->val)));
+            } else {
+                other._remove_from_list(curr);
+                _append_to_list(curr);
+            }
             _size++;
+            curr = next;
+        }
+        other.clear();
+    }
+
+    void _delete_all_nodes() {
+        //deletes every node on the node list
+        //with an allocator that can drop all of its memory at once (PoolAllocator)
+        //that no other container shares and that our nodes were actually
+        //carved from (not passed on to operator new), we only run the destructors
+        //(if there are any to run) and then hand back whole chunks
+        HashNode* curr = _head;
+        if constexpr (requires(node_allocator & a) {
+                          a.release();
+                          { a.exclusive() } -> std::convertible_to<bool>;
+                          { a.pooled() } -> std::convertible_to<bool>;
+                      }) {
+            if(_node_alloc.exclusive() && _node_alloc.pooled()) {
+                if constexpr (!std::is_trivially_destructible_v<HashNode>) {
+                    while(curr) {
+                        HashNode* node = curr;
+                        curr = curr->list_next;
+                        node_traits::destroy(_node_alloc, node);
+                    }
+                }
+                _node_alloc.release();
+                return;
+            }
+        }
+        while(curr) {
+            HashNode* node = curr;
+            curr = curr->list_next;
+            _delete_node(node);
+        }
+    }
+
+    void _append_to_list(HashNode * node) {
+        //adds node to the end of the threaded node list
+        node->list_prev = _tail;
+        node->list_next = nullptr;
+        if(_tail) {
+            _tail->list_next = node;
+        } else {
+            _head = node;
+        }
+        _tail = node;
+    }
+
+    void _remove_from_list(HashNode * node) {
+        if(node->list_prev) {
+            node->list_prev->list_next = node->list_next;
+        } else {
+            _head = node->list_next;
+        }
+        if(node->list_next) {
+            node->list_next->list_prev = node->list_prev;
+        } else {
+            _tail = node->list_prev;
+        }
+    }
+
+    HashNode * _link(size_t code, HashNode * node) {
+        //links a freshly allocated node (whose key is not in the map yet)
+        //into the bucket for hash code, growing first if needed
+        //and appends it to the node list
+        //a small map only appends it, unless it is full and has to be promoted,
+        //in which case node's code is computed here
+
+        if(_small()) {
+            if(_size < InlineCapacity) {
+                _append_to_list(node);
+                _size++;
+                return node;
+            }
+            _promote();
+            code = _hash_code((node->val).first);
+        }
+
+        _grow_for_insert();
+
+        node->hash = code;
+        HashNode*& bucket = _slot(_position(code));
+        node->next = bucket;
+        bucket = node;
+        _append_to_list(node);
+        _size++;
+
+        if constexpr (_reseedable) {
+            _check_chain(node);
+        }
+        return node;
+    }
+
+    void _check_chain(HashNode * head) {
+        //counts the chain starting at head (just walked by the lookup before the
+        //insert, so it is still in cache), stopping at the limit
+        //a chain that long is next to impossible with a random seed unless the
+        //keys were picked to collide, so we reseed and rehash every key
+        double limit = std::max<double>(_long_chain_minimum, _long_chain_factor * _max_load_factor);
+        if(_reseeded_at == _bucket_count || _size <= limit) {
+            return;
+        }
+        size_type length = 0;
+        for(HashNode* curr = head; curr && length <= limit; curr = curr->next) {
+            length++;
+        }
+        if(length > limit) {
+            reseed();
+        }
+    }
+
+    template <typename V>
+    std::pair<HashNode *, bool> _insert_unique(V && value) {
+        //inserts value unless its key is already in the map
+        //if key exists, but value is diff we redefine the mapped value
+        //returns the node holding the key and whether a new node was created
+        return _insert_unique(_code_for(value.first), std::forward<V>(value));
+    }
+
+    template <typename V>
+    std::pair<HashNode *, bool> _insert_unique(size_t code, V && value) {
+        //same as above with the hash code of value's key already computed
+        HashNode* curr = _find(code, value.first);
+        if(curr) {
+            if((curr->val).second != value.second) {
+                (curr->val).second = value.second;
+            }
+            return {curr, false};
         }
+        return {_link(code, _new_node(std::forward<V>(value))), true};
+    }
+
+    template <typename K, typename... Args>
+    std::pair<HashNode *, bool> _try_emplace(K && key, Args &&... args) {
+        //looks key up and only if it is missing builds the new element in place,
+        //the key from key and the mapped value from args
+        //an existing element is left untouched
+
+        size_t code = _code_for(key);
+        HashNode* curr = _find(code, key);
+        if(curr) {
+            return {curr, false};
+        }
+        HashNode* node = _new_node(std::in_place, std::piecewise_construct,
+                                   std::forward_as_tuple(std::forward<K>(key)),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+        return {_link(code, node), true};
+    }
+
+    template <typename K, typename M>
+    std::pair<HashNode *, bool> _insert_or_assign(K && key, M && obj) {
+        //assigns obj to the mapped value of key, inserting key if it is missing
+
+        size_t code = _code_for(key);
+        HashNode* curr = _find(code, key);
+        if(curr) {
+            (curr->val).second = std::forward<M>(obj);
+            return {curr, false};
+        }
+        HashNode* node = _new_node(std::in_place, std::piecewise_construct,
+                                   std::forward_as_tuple(std::forward<K>(key)),
+                                   std::forward_as_tuple(std::forward<M>(obj)));
+        return {_link(code, node), true};
+    }
+
+    template <typename K, typename M>
+    std::pair<iterator, bool> _emplace_pair(K && key, M && obj) {
+        //emplace(key, mapped) is a try_emplace that builds the mapped value from obj
+        std::pair<HashNode *, bool> inserted = _try_emplace(std::forward<K>(key), std::forward<M>(obj));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    void _unlink_node(HashNode * target) {
+        //takes target out of its bucket and the node list without deleting it
+        //we traverse the bucket with a prev and curr pointer and when we find
+        //the node we set prev.next to the node's next
+        //if prev is nullptr then the node was the first one in the bucket
+
+        if(!_small()) {
+            HashNode*& bucket = _slot(_position(target->hash));
+
+            HashNode* prev = nullptr;
+            HashNode* curr = bucket;
+            while(curr != target) {
+                prev = curr;
+                curr = curr->next;
+            }
 
-        if(!_head || bucket <= head_bucket) {
-            _head = newNode;
+            if(!prev) {
+                bucket = curr->next;
+            } else {
+                prev->next = curr->next;
+            }
         }
-        
+        _remove_from_list(target);
+        _size--;
+    }
+
+    HashNode * _erase_node(HashNode * target) {
+        //unlinks target from its bucket and the node list, deletes it and
+        //returns the node that followed it in iteration order
+        HashNode* next = target->list_next;
+        _unlink_node(target);
+        _delete_node(target);
+        return next;
+    }
 
-        return newNode;
+    HashNode * _detach_node(HashNode * target) {
+        //unlinks target and hands it over to the caller, who becomes
+        //responsible for destroying and deallocating it through _node_alloc
+        //a node in an inline slot can't leave the map, its element is moved
+        //into a newly allocated node instead (before anything is unlinked, so
+        //if that throws the map is unchanged)
+        //the returned node always carries the key's hash code, a small map
+        //computes it here
+        HashNode* node = target;
+        if(_is_inline(target)) {
+            node = node_traits::allocate(_node_alloc, 1);
+            try {
+                node_traits::construct(_node_alloc, node, std::move(target->val));
+            } catch(...) {
+                node_traits::deallocate(_node_alloc, node, 1);
+                throw;
+            }
+        }
+        node->hash = _small() ? _hash_code((node->val).first) : target->hash;
+        if(node != target) {
+            _erase_node(target);
+        } else {
+            _unlink_node(target);
+        }
+        return node;
+    }
+
+    size_t _adopted_code(const HashNode * node, bool cached) const {
+        //the hash code to link a node from another map with, the code cached in
+        //it (if cached) is only reused for a stateless hasher, a seeded one has
+        //a seed of its own in every map
+        if constexpr (std::is_empty_v<Hash>) {
+            if(cached) {
+                return _small() ? 0 : node->hash;
+            }
+        }
+        return _code_for((node->val).first);
+    }
+
+    template <typename OtherAlloc>
+    bool _shares_allocator(const OtherAlloc & other) const {
+        //nodes may only be relinked between maps whose allocators can free each
+        //other's memory (PoolAllocators of different maps have separate pools)
+        if constexpr (node_traits::is_always_equal::value) {
+            return true;
+        } else {
+            return _node_alloc == other;
+        }
+    }
+
+    void _copy_nodes(const UnorderedMap & other) {
+        //fills our (empty) buckets with copies of every node in other
+        //other may be in the middle of an incremental rehash so we walk
+        //its node list and rebucket each copy using the cached hash code
+        //a copy of a small map is small too and only needs the list
+        _head = nullptr;
+        _tail = nullptr;
+        for(HashNode* curr = other._head; curr; curr = curr->list_next) {
+            HashNode* node = _new_node(curr->val);
+            if(_small()) {
+                _append_to_list(node);
+                continue;
+            }
+            node->hash = curr->hash;
+            size_type index = _range.index(node->hash);
+            node->next = _buckets[index];
+            _buckets[index] = node;
+            _append_to_list(node);
+        }
+        _size = other._size;
     }
 
     void _move_content(UnorderedMap & src, UnorderedMap & dst) {
@@ -289,104 +1305,287 @@ private:
             //_bucket_count
             //_size
             //_equal
+            //the old bucket array if src is mid rehash
         dst._buckets = std::move(src._buckets);
         dst._hash = std::move(src._hash);
         dst._bucket_count = std::move(src._bucket_count);
         dst._equal = std::move(src._equal);
         dst._size = std::move(src._size);
         dst._head = std::move(src._head);
+        dst._tail = std::move(src._tail);
+        dst._max_load_factor = std::move(src._max_load_factor);
+        dst._old_buckets = std::move(src._old_buckets);
+        dst._old_bucket_count = std::move(src._old_bucket_count);
+        dst._migrated = std::move(src._migrated);
+        dst._range = src._range;
+        dst._old_range = src._old_range;
+        dst._incremental = std::move(src._incremental);
+        dst._rehash_step = std::move(src._rehash_step);
+        dst._reseeded_at = src._reseeded_at;
 
     }
 
+    //snapshots (see snapshot.h) copy the elements in blocks when both types
+    //are plain bytes, and write one record per element otherwise
+    static constexpr bool _block_snapshot = std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>
+                                            && std::is_default_constructible_v<Key>
+                                            && std::is_default_constructible_v<T>;
+    static constexpr snapshot_header::layout_type _snapshot_layout =
+        _block_snapshot ? snapshot_header::blocks : snapshot_header::records;
+    static constexpr uint64_t _snapshot_key_size = _block_snapshot ? sizeof(Key) : 0;
+    static constexpr uint64_t _snapshot_mapped_size = _block_snapshot ? sizeof(T) : 0;
+    //elements made room for up front when the snapshot's size can't be checked
+    static constexpr size_type _snapshot_presize = 16 * snapshot_block;
+
+    template <typename Writer>
+    void _write_snapshot(Writer & out) const {
+        //the header, then every element in iteration order with its hash code
+        //(a small map caches no codes, so they are computed here)
+        snapshot_header header = snapshot_header::make(_snapshot_layout, _snapshot_key_size, _snapshot_mapped_size,
+                                                       _size, _bucket_count);
+        out.write(&header, sizeof(header));
+        auto code_of = [&](const HashNode * node) -> uint64_t {
+            return _small() ? _hash_code((node->val).first) : node->hash;
+        };
+
+        if constexpr (_block_snapshot) {
+            size_type block = std::min(_size, snapshot_block);
+            std::unique_ptr<uint64_t[]> codes(new uint64_t[block]);
+            std::unique_ptr<Key[]> keys(new Key[block]);
+            std::unique_ptr<T[]> values(new T[block]);
+            for(const HashNode* curr = _head; curr; ) {
+                size_type m = 0;
+                for(; curr && m < block; curr = curr->list_next, m++) {
+                    codes[m] = code_of(curr);
+                    keys[m] = (curr->val).first;
+                    values[m] = (curr->val).second;
+                }
+                out.write(codes.get(), m * sizeof(uint64_t));
+                out.write(keys.get(), m * sizeof(Key));
+                out.write(values.get(), m * sizeof(T));
+            }
+        } else {
+            for(const HashNode* curr = _head; curr; curr = curr->list_next) {
+                uint64_t code = code_of(curr);
+                out.write(&code, sizeof(code));
+                snapshot_codec<Key>::write(out, (curr->val).first);
+                snapshot_codec<T>::write(out, (curr->val).second);
+            }
+        }
+        out.flush();
+    }
+
+    template <typename Reader>
+    void _read_snapshot(Reader & in) {
+        //replaces our elements with the snapshot's
+        //the stored hash codes are used as they are, unless our hasher gives
+        //the first key another code (a different hasher or seed), in which
+        //case every key is hashed again
+        snapshot_header header;
+        in.read(&header, sizeof(header));
+        header.check(_snapshot_layout, _snapshot_key_size, _snapshot_mapped_size);
+        //every element takes at least the 8 bytes of its hash code
+        if(header.size > SIZE_MAX / 16) {
+            throw std::runtime_error("UnorderedMap snapshot is corrupt");
+        }
+        size_type n = header.size;
+        in.check_remaining(n * sizeof(uint64_t));
+
+        clear();
+        //the snapshot's bucket count is kept, unless it is far more than the
+        //elements need (a map that had most of its elements erased)
+        //a small map stays small if the elements fit
+        auto buckets_for = [&](size_type count) {
+            size_type needed = _min_buckets_for(count);
+            return header.bucket_count <= needed * 8 ? std::max<size_type>(header.bucket_count, needed) : needed;
+        };
+        //a stream can't vouch for the header's size, so only up to
+        //_snapshot_presize elements are made room for before they arrive and
+        //the table grows as the rest are read
+        size_type expected = Reader::checks_remaining ? n : std::min(n, _snapshot_presize);
+        if(n > InlineCapacity) {
+            size_type count = buckets_for(expected);
+            if(_small()) {
+                _bucket_count = count;
+                _promote();
+            } else {
+                rehash(count);
+            }
+        }
+
+        bool checked = false;
+        bool rehash_codes = false;
+        auto add = [&](uint64_t code, Key && key, T && value) {
+            if(_size == expected && !_small()) {
+                expected = std::min(n, expected * 2);
+                rehash(_min_buckets_for(expected));
+            }
+            HashNode* node = _new_node(std::in_place, std::move(key), std::move(value));
+            if(!_small()) {
+                if(!checked) {
+                    checked = true;
+                    rehash_codes = _hash_code((node->val).first) != code;
+                }
+                node->hash = rehash_codes ? _hash_code((node->val).first) : static_cast<size_t>(code);
+                size_type index = _range.index(node->hash);
+                node->next = _buckets[index];
+                _buckets[index] = node;
+            }
+            _append_to_list(node);
+            _size++;
+        };
+
+        if constexpr (_block_snapshot) {
+            size_type block = std::min(n, snapshot_block);
+            std::unique_ptr<uint64_t[]> codes(new uint64_t[block]);
+            std::unique_ptr<Key[]> keys(new Key[block]);
+            std::unique_ptr<T[]> values(new T[block]);
+            for(size_type done = 0; done < n; ) {
+                size_type m = std::min(n - done, block);
+                in.read(codes.get(), m * sizeof(uint64_t));
+                in.read(keys.get(), m * sizeof(Key));
+                in.read(values.get(), m * sizeof(T));
+                for(size_type i = 0; i < m; i++) {
+                    add(codes[i], std::move(keys[i]), std::move(values[i]));
+                }
+                done += m;
+            }
+        } else {
+            for(size_type i = 0; i < n; i++) {
+                uint64_t code;
+                in.read(&code, sizeof(code));
+                Key key = snapshot_codec<Key>::read(in);
+                T value = snapshot_codec<T>::read(in);
+                add(code, std::move(key), std::move(value));
+            }
+        }
+        if(_size > _snapshot_presize && !Reader::checks_remaining) {
+            //every element arrived, so the bucket count can be trusted now
+            rehash(buckets_for(_size));
+        }
+    }
+
 public:
     explicit UnorderedMap(size_type bucket_count, const Hash & hash = Hash { },
-                const key_equal & equal = key_equal { }) {
-        bucket_count = next_greater_prime(bucket_count);
-        _buckets = new HashNode*[bucket_count]{};
+                const key_equal & equal = key_equal { }, const Alloc & alloc = Alloc { })
+        : _node_alloc(alloc), _hash(hash), _equal(equal) {
+        //a map with inline slots starts small, bucket_count is kept for the promotion
+        bucket_count = RangePolicy::bucket_count_for(bucket_count);
+        _buckets = InlineCapacity > 0 ? nullptr : new HashNode*[bucket_count]{};
         _bucket_count = bucket_count;
-        _hash = hash;
-        _equal = equal;
+        _range.reset(bucket_count);
+        _old_buckets = nullptr;
+        _old_bucket_count = 0;
+        _migrated = 0;
         _head = nullptr;
+        _tail = nullptr;
         _size = 0;
+        _max_load_factor = 1.0f;
+        _incremental = false;
+        _rehash_step = 8;
+        _reseeded_at = 0;
+    }
+
+    template <std::ranges::random_access_range Values>
+        requires std::ranges::sized_range<Values>
+    UnorderedMap(parallel_build_t, const Values & values, size_type threads = 0, const Hash & hash = Hash { },
+                 const key_equal & equal = key_equal { }, const Alloc & alloc = Alloc { })
+        : UnorderedMap(0, hash, equal, alloc) {
+        //builds the map from a range of (key, mapped) pairs on threads threads
+        //(0 for one per core) with the result insert would give, except for
+        //the iteration order, which groups the elements by bucket range
+        //
+        //the buckets are split into one contiguous range per thread: every
+        //thread first hashes a slice of the input and sorts it by range, then
+        //links the elements of its own range, so no two threads ever touch the
+        //same bucket and nothing is locked. Nodes come from an allocator per
+        //thread (its own pool for PoolAllocator, handed over to the map after)
+        //an allocator that is neither always equal nor a PoolAllocator can't
+        //be shared between threads and the build runs on the calling thread
+        size_type n = std::ranges::size(values);
+        if(threads == 0) {
+            threads = std::max<size_type>(std::thread::hardware_concurrency(), 1);
+        }
+        //below a few thousand elements per thread starting threads costs more than it saves
+        threads = std::clamp<size_type>(n / 4096, 1, threads);
+        if constexpr (!node_traits::is_always_equal::value && !requires(node_allocator & a) { a.adopt(a); }) {
+            threads = 1;
+        }
+
+        if(n <= InlineCapacity) {
+            for(const auto & value : values) {
+                insert_or_assign(value.first, value.second);
+            }
+            return;
+        }
+        if(_small()) {
+            _bucket_count = _min_buckets_for(n);
+            _promote();
+        } else {
+            rehash(_min_buckets_for(n));
+        }
+        //the delegated constructor has finished, so if this throws the
+        //destructor frees whatever was built
+        _build_parallel(values, threads);
     }
 
     ~UnorderedMap() {
         //destructor for our hash map
         //we need to deallocate all nodes we have allocated
-        
-        //1. for loop to traverse thru bucket indexes
-        //2. for each bucket in buckets, traverse bucket and delete all nodes in bucket
+        //clear walks both bucket arrays and deletes every node
+        //then we release the bucket array itself
 
-        for(size_t i = 0; i < _bucket_count; i++) {
-            HashNode* curr = _buckets[i];
-            while(curr) {
-                HashNode* node = curr;
-                curr = curr->next;
-                delete node;
-            }
-            _buckets[i] = nullptr;
-        }
-        delete _buckets;
-        _head = nullptr;
+        clear();
+        delete[] _buckets;
         _buckets = nullptr;
 
 
     }
 
-    UnorderedMap(const UnorderedMap & other) {
+    UnorderedMap(const UnorderedMap & other)
+        : _node_alloc(node_traits::select_on_container_copy_construction(other._node_alloc)),
+          _hash(other._hash), _equal(other._equal) {
         //copy constructor
         //instantiates a new hashmap using another hashmap's values
-        
+
         //for _hash, _equal, and _bucket_count we can just copy normally
-        //for our _buckets we will need to traverse thru other's buckets
+        //for our _buckets we will need to traverse thru other's nodes
         //and allocate nodes manually
 
-        _hash = other._hash;
-        _equal = other._equal;
         _bucket_count = other._bucket_count;
-        _buckets = new HashNode*[_bucket_count]{};
-        _size = other._size;
-
-        bool isHead = true;
-
-        for(size_type i = 0; i < other._bucket_count; i++) {
-            //traverse thru every bucket
-            //for each bucket, while there are nodes create new nodes
-            HashNode* prev = nullptr;
-            HashNode* curr = other._buckets[i];
-
-            while(curr) {
-                HashNode * node = new HashNode(curr->val);
-                if(!prev) {
-                    if(isHead) {
-                        _head = node;
-                        isHead = false;
-                    }
-                    _buckets[i] = node;
-                } else {
-                    prev->next = node;
-                }
-                prev = node;
-                curr = curr->next;
-
-
-            }
-        }
+        _buckets = other._small() ? nullptr : new HashNode*[_bucket_count]{};
+        _range = other._range;
+        _old_buckets = nullptr;
+        _old_bucket_count = 0;
+        _migrated = 0;
+        _max_load_factor = other._max_load_factor;
+        _incremental = other._incremental;
+        _rehash_step = other._rehash_step;
+        _reseeded_at = other._reseeded_at;
+        _copy_nodes(other);
 
     }
 
-    UnorderedMap(UnorderedMap && other) {
+    UnorderedMap(UnorderedMap && other)
+        : _node_alloc(std::move(other._node_alloc)), _hash(other._hash), _equal(other._equal) {
         //move constructor
-        _bucket_count = other._bucket_count;
-        _hash = other._hash;
-        _equal = other._equal;
-        _buckets = other._buckets;
-        _size = other._size;
-        _head = other._head;
+        //the nodes come along with their allocator, other gets a fresh one
+        //(for PoolAllocator that means a pool of its own)
+        _move_content(other, *this);
+        other._node_alloc = node_traits::select_on_container_copy_construction(_node_alloc);
+        if(_small()) {
+            _take_inline_nodes(other);
+            return;
+        }
 
-        other._buckets = new HashNode*[_bucket_count]{ };
+        //other goes back to being small if it can
+        other._buckets = InlineCapacity > 0 ? nullptr : new HashNode*[_bucket_count]{ };
+        other._old_buckets = nullptr;
+        other._old_bucket_count = 0;
+        other._migrated = 0;
         other._size = 0;
         other._head = nullptr;
+        other._tail = nullptr;
 
 
 
@@ -395,35 +1594,17 @@ public:
     UnorderedMap & operator=(const UnorderedMap & other) {
         if(this != &other) {
             this->clear();
-            delete _buckets;
+            delete[] _buckets;
             _hash = other._hash;
             _equal = other._equal;
             _bucket_count = other._bucket_count;
-            _buckets = new HashNode*[_bucket_count]{};
-            _size = other._size;
-
-            for(size_type i = 0; i < other._bucket_count; i++) {
-                //traverse thru every bucket
-                //for each bucket, while there are nodes create new nodes
-                HashNode* prev = nullptr;
-                HashNode* curr = other._buckets[i];
-                bool isHead = true;
-                while(curr) {
-                    HashNode * node = new HashNode(curr->val);
-                    if(!prev) {
-                        if(isHead) {
-                            _head = node;
-                            isHead = false;
-                        }
-                        _buckets[i] = node;
-                    } else {
-                        prev->next = node;
-                    }
-                    prev = node;
-                    curr = curr->next;
-
-                }
-            }
+            _buckets = other._small() ? nullptr : new HashNode*[_bucket_count]{};
+            _range = other._range;
+            _max_load_factor = other._max_load_factor;
+            _incremental = other._incremental;
+            _rehash_step = other._rehash_step;
+            _reseeded_at = other._reseeded_at;
+            _copy_nodes(other);
 
         }
         return *this;
@@ -432,27 +1613,45 @@ public:
     UnorderedMap & operator=(UnorderedMap && other) {
         if(this != &other) {
             this->clear();
-            delete _buckets;
+            delete[] _buckets;
             _move_content(other, *this);
-            
+            //our nodes were all freed above, so we simply take other's allocator
+            _node_alloc = std::move(other._node_alloc);
+            other._node_alloc = node_traits::select_on_container_copy_construction(_node_alloc);
+            if(_small()) {
+                _take_inline_nodes(other);
+                return *this;
+            }
+
             other._size = 0;
-            other._buckets = new HashNode*[other._bucket_count]{};
+            other._buckets = InlineCapacity > 0 ? nullptr : new HashNode*[other._bucket_count]{};
+            other._old_buckets = nullptr;
+            other._old_bucket_count = 0;
+            other._migrated = 0;
             other._head = nullptr;
+            other._tail = nullptr;
         }
         return *this;
     }
 
     void clear() noexcept {
-        for(size_t i = 0; i < _bucket_count; i++) {
-            HashNode* curr = _buckets[i];
-            while(curr) {
-                HashNode* node = curr;
-                curr = curr->next;
-                delete node;
-            }
-            _buckets[i] = nullptr;
-            _size = 0;
+        //every node is on the node list, so we delete along it
+        //and then just zero the bucket arrays
+        _delete_all_nodes();
+        if constexpr (InlineCapacity > 0) {
+            _inline_used = 0;
         }
+        if(_buckets) {
+            std::fill(_buckets, _buckets + _bucket_count, nullptr);
+        }
+        //an unfinished incremental rehash has nothing left to move
+        delete[] _old_buckets;
+        _old_buckets = nullptr;
+        _old_bucket_count = 0;
+        _migrated = 0;
+        _size = 0;
+        _head = nullptr;
+        _tail = nullptr;
 
     }
 
@@ -460,17 +1659,21 @@ public:
         return _size;
     }
 
+    allocator_type get_allocator() const {
+        return allocator_type(_node_alloc);
+    }
+
     bool empty() const noexcept {
         return _size == 0;
     }
 
     size_type bucket_count() const noexcept {
-        return _bucket_count;
+        return _small() ? 0 : _bucket_count;
     }
 
     iterator begin() {
         //returns an iterator pointing to the first element in the Hash Map
-        //first element in our hashmap will be set to _head
+        //first element in our hashmap is the head of the node list
         //create a new iterator using _head HashNode
         iterator start(this, _head);
         return start;
@@ -491,18 +1694,29 @@ public:
         return end;
     };
 
+    //the bucket interface below only looks at the current bucket array,
+    //keys still waiting in the old array of an incremental rehash are not counted
+    //a small map has no bucket array (bucket_count() is 0), every bucket of it
+    //reads as empty
+
     local_iterator begin(size_type n) {
+        if(_small()) {
+            return end(n);
+        }
         HashNode* first = _buckets[n];
         local_iterator start(first);
         return start;
     }
     local_iterator end(size_type n) {
        local_iterator end(nullptr);
-       return end; 
+       return end;
     }
 
     size_type bucket_size(size_type n) {
         //returns size of bucket at index n
+        if(_small()) {
+            return 0;
+        }
         HashNode* curr = _buckets[n];
         size_type count = 0;
 
@@ -516,187 +1730,546 @@ public:
     float load_factor() const {
        //returns load_factor
        //load factor is the number of elements inside the hashmap divided by number of buckets
+       if(_small()) {
+           return 0;
+       }
        return _size / static_cast<float>(_bucket_count);
     }
 
+    hash_table_stats stats() const {
+        //measures the chains (see hash_table_stats) with one walk over every
+        //bucket, O(size + bucket_count), and copies the counters if there are any
+        //while an incremental rehash is running the old buckets not yet moved
+        //are counted too, a find still looks in them
+        hash_table_stats result;
+        result.size = _size;
+        result.bucket_count = bucket_count();
+        result.load_factor = load_factor();
+
+        if(_small()) {
+            //one chain holding everything, in inline slots that cost no allocation
+            result.successful_probes.assign(_size + 1, 1);
+            result.successful_probes[0] = 0;
+            result.unsuccessful_probes.assign(_size + 1, 0);
+            result.unsuccessful_probes[_size] = 1;
+            result.longest_chain = _size;
+            result.average_successful_probes = _size > 0 ? (_size + 1) / 2.0 : 0;
+            result.average_unsuccessful_probes = _size;
+        } else {
+            result.bytes_allocated = _size * sizeof(HashNode) + _end_position() * sizeof(HashNode*);
+            size_type buckets = 0;
+            size_t probes = 0;
+            double squares = 0;
+            for(size_type position = 0; position < _end_position(); position++) {
+                if(position >= _bucket_count && position - _bucket_count < _migrated) {
+                    //already drained into the new array
+                    continue;
+                }
+                size_type length = 0;
+                for(HashNode* curr = _slot(position); curr; curr = curr->next) {
+                    length++;
+                    if(result.successful_probes.size() <= length) {
+                        result.successful_probes.resize(length + 1);
+                    }
+                    result.successful_probes[length]++;
+                    probes += length;
+                }
+                if(result.unsuccessful_probes.size() <= length) {
+                    result.unsuccessful_probes.resize(length + 1);
+                }
+                result.unsuccessful_probes[length]++;
+                result.longest_chain = std::max(result.longest_chain, length);
+                squares += static_cast<double>(length) * length;
+                buckets++;
+            }
+
+            if(_size > 0) {
+                result.average_successful_probes = probes / static_cast<double>(_size);
+            }
+            double mean = _size / static_cast<double>(buckets);
+            result.average_unsuccessful_probes = mean;
+            result.chain_length_variance = squares / buckets - mean * mean;
+        }
+
+#ifdef UNORDERED_MAP_STATS
+        result.counters_enabled = true;
+        result.hash_calls = _counters.hash_calls.load(std::memory_order_relaxed);
+        result.key_comparisons = _counters.key_comparisons.load(std::memory_order_relaxed);
+        result.rehashes = _counters.rehashes.load(std::memory_order_relaxed);
+        result.rehash_time = std::chrono::nanoseconds(_counters.rehash_time.load(std::memory_order_relaxed));
+#endif
+        return result;
+    }
+
+    void reset_stats() noexcept {
+        //zeroes the counters, e.g. to measure a single phase of a workload
+#ifdef UNORDERED_MAP_STATS
+        _counters.reset();
+#endif
+    }
+
     size_type bucket(const Key & key) const {
         //returns index of bucket for given key
+        //a small map has no buckets, so the index means nothing until it is
+        //promoted (bucket_size and begin(n) treat any index as an empty bucket)
         return _bucket(key);
     }
 
-    std::pair<iterator, bool> insert(value_type && value) {
-        //inserts value into hash map
-        //makes sure inserted value is not already inside list
-        //uses move semantics
-        bool exists = false;
-        size_type bucket_index = _bucket(value);
-        HashNode* insertedNode = nullptr;
+    float max_load_factor() const noexcept {
+        return _max_load_factor;
+    }
 
-        //traverse thru bucket determine if value exists already
-        //if key exists, but value is diff redefine val?
-        HashNode* curr = _buckets[bucket_index];
-        while(curr) {
-            if((curr->val).first == value.first) {
-                exists = true;
-                insertedNode = curr;
-                if((curr->val).second != value.second) {
-                    (curr->val).second = value.second;
-                }
-                break;
+    void max_load_factor(float ml) {
+        //sets the load factor we are allowed to reach before growing
+        //and grows right away if we are already past it
+        _max_load_factor = ml;
+        if(load_factor() > _max_load_factor) {
+            rehash(_min_buckets_for(_size));
+        }
+    }
+
+    void rehash(size_type count) {
+        //rebuilds the bucket array with at least count buckets (and at least
+        //enough to respect max_load_factor), rounded up to a bucket count the
+        //RangePolicy supports (the next prime on the doubling ladder by default)
+        //nodes are relinked into the new array using their cached hash codes,
+        //nothing is reallocated, copied or rehashed and iteration order is unchanged
+        //an explicit rehash always runs to completion, even in incremental mode
+        //a small map is promoted, with count buckets or more
+
+        if(_small()) {
+            _bucket_count = std::max(_bucket_count, count);
+            _promote();
+            return;
+        }
+        _finish_rehash();
+
+        count = RangePolicy::bucket_count_for(std::max(count, _min_buckets_for(_size)));
+        if(count == _bucket_count) {
+            return;
+        }
+
+        RehashTimer timer(this);
+        RangePolicy range;
+        range.reset(count);
+        HashNode** newBuckets = new HashNode*[count]{};
+        for(size_type i = 0; i < _bucket_count; i++) {
+            HashNode* curr = _buckets[i];
+            while(curr) {
+                HashNode* next = curr->next;
+                size_type index = range.index(curr->hash);
+                curr->next = newBuckets[index];
+                newBuckets[index] = curr;
+                curr = next;
             }
-            curr = curr->next;
         }
 
-        if(!exists) {
-            insertedNode = _insert_into_bucket(bucket_index, std::move(value));
+        delete[] _buckets;
+        _buckets = newBuckets;
+        _bucket_count = count;
+        _range = range;
+    }
+
+    void reserve(size_type count) {
+        //makes room for count elements without growing again
+        //(a small map stays small as long as they fit in the inline slots)
+        if(_small() && count <= InlineCapacity) {
+            return;
+        }
+        rehash(_min_buckets_for(count));
+    }
+
+    bool incremental_rehash() const noexcept {
+        return _incremental;
+    }
+
+    void incremental_rehash(bool enabled, size_type buckets_per_step = 8) {
+        //in incremental mode growing only allocates the new bucket array, the
+        //old one is kept and every insert/find/erase moves up to buckets_per_step
+        //populated buckets across, so no single operation pays for a full rehash
+        //turning the mode off finishes any rehash still in progress
+        _incremental = enabled;
+        _rehash_step = std::max<size_type>(buckets_per_step, 1);
+        if(!_incremental) {
+            _finish_rehash();
         }
+    }
+
+    bool rehashing() const noexcept {
+        //true while an incremental rehash still has buckets to move
+        return _old_buckets != nullptr;
+    }
+
+    void reseed() requires _reseedable {
+        //gives the hasher a new random seed and rehashes every key with it
+        //(the cached hash codes are all stale), into a fresh bucket array of the
+        //same size, iteration order is unchanged
+        //inserts call this on their own when they find a suspiciously long chain
+        //a small map has no hash codes, it only needs the new seed
+
+        if(_small()) {
+            _hash.reseed();
+            return;
+        }
+        _finish_rehash();
+        RehashTimer timer(this);
+        HashNode** newBuckets = new HashNode*[_bucket_count]{};
+        _hash.reseed();
+
+        for(HashNode* curr = _head; curr; curr = curr->list_next) {
+            curr->hash = _hash_code((curr->val).first);
+            size_type index = _range.index(curr->hash);
+            curr->next = newBuckets[index];
+            newBuckets[index] = curr;
+        }
+
+        delete[] _buckets;
+        _buckets = newBuckets;
+        _reseeded_at = _bucket_count;
+    }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        //inserts value into hash map
+        //makes sure inserted value is not already inside list
+        //uses move semantics
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _insert_unique(std::move(value));
+
+        iterator nodeIterator(this, inserted.first);
+        std::pair<iterator, bool> insertPair(nodeIterator, inserted.second);
 
-        iterator nodeIterator(this, insertedNode);
-        std::pair<iterator, bool> insertPair(nodeIterator, !exists);
-        
         return insertPair;
     }
 
     std::pair<iterator, bool> insert(const value_type & value) {
-        bool exists = false;
-        size_type bucket_index = _bucket(value.first);
-        HashNode* insertedNode = nullptr;
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _insert_unique(value);
 
-        //traverse thru bucket determine if value exists already
-        //if key exists, but value is diff redefine val?
-        HashNode* curr = _buckets[bucket_index];
-        while(curr) {
-            if((curr->val).first == value.first) {
-                exists = true;
-                insertedNode = curr;
-                if((curr->val).second != value.second) {
-                    (curr->val).second = value.second;
-                }
-                break;
-            }
-            curr = curr->next;
-        }
+        iterator nodeIterator(this, inserted.first);
+        std::pair<iterator, bool> insertPair(nodeIterator, inserted.second);
 
-        if(!exists) {
-            //create new node
-            //insert it at bucket_index
-            //redefine _head if needed
+        return insertPair;
+    }
 
-            HashNode* newNode = new HashNode(value, _buckets[bucket_index]);
-            _buckets[bucket_index] = newNode;
-            if(_head) {
-                size_t head_index = _bucket(_head->val);
-                if(bucket_index <= head_index) {
-                    _head = newNode;
-                }
-            } else {
-                _head = newNode;
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        //constructs the element in place unless its key is already in the map,
+        //unlike insert an existing element keeps its mapped value
+        //a (key, mapped) argument pair is looked up before anything is built,
+        //otherwise we need the node first to know its key
+
+        _rehash_step_if_needed();
+        if constexpr (sizeof...(Args) == 2) {
+            if constexpr (std::is_same_v<std::remove_cvref_t<std::tuple_element_t<0, std::tuple<Args...>>>, Key>) {
+                return _emplace_pair(std::forward<Args>(args)...);
             }
+        }
 
-            insertedNode = newNode;
-            _size++;
+        HashNode* node = _new_node(std::in_place, std::forward<Args>(args)...);
+        size_t code = _code_for((node->val).first);
+        HashNode* curr = _find(code, (node->val).first);
+        if(curr) {
+            _delete_node(node);
+            return {iterator(this, curr), false};
         }
+        return {iterator(this, _link(code, node)), true};
+    }
 
-        iterator nodeIterator(this, insertedNode);
-        std::pair<iterator, bool> insertPair(nodeIterator, !exists);
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key & key, Args &&... args) {
+        //inserts key with a mapped value constructed from args if key is missing
+        //args are not touched (not even moved from) when key is already there
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _try_emplace(key, std::forward<Args>(args)...);
+        return {iterator(this, inserted.first), inserted.second};
+    }
 
-        return insertPair;
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(Key && key, Args &&... args) {
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _try_emplace(std::move(key), std::forward<Args>(args)...);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    template <typename K, typename... Args>
+        requires _transparent && std::is_constructible_v<Key, K>
+    std::pair<iterator, bool> try_emplace(K && key, Args &&... args) {
+        //a Key is only built from key if it has to be inserted
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key & key, M && obj) {
+        //inserts (key, obj) or assigns obj to the mapped value of an existing key
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _insert_or_assign(key, std::forward<M>(obj));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(Key && key, M && obj) {
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _insert_or_assign(std::move(key), std::forward<M>(obj));
+        return {iterator(this, inserted.first), inserted.second};
+    }
+
+    template <typename K, typename M>
+        requires _transparent && std::is_constructible_v<Key, K>
+    std::pair<iterator, bool> insert_or_assign(K && key, M && obj) {
+        _rehash_step_if_needed();
+        std::pair<HashNode *, bool> inserted = _insert_or_assign(std::forward<K>(key), std::forward<M>(obj));
+        return {iterator(this, inserted.first), inserted.second};
     }
 
     iterator find(const Key & key) {
         //finds and returns iterator to HashNode with given key
+        _rehash_step_if_needed();
         HashNode* node = _find(key);
         iterator target(this, node);
 
         return target;
     }
 
-    T& operator[](const Key & key) {
-        //finds node with given key and returns it's data
-        //find bucket for given key
-        //traverses bucket for key
-        //if it exists then return the mapped value associated with key
-        //if it does not exist, insert it into that bucket
-        //and return mapped val if inserted key
-
-        size_type bucket_index = _bucket(key);
-        HashNode* curr = _buckets[bucket_index];
-        while(curr) {
-            if((curr->val).first == key) {
-                return (curr->val).second;
+    template <typename K>
+        requires _transparent
+    iterator find(const K & key) {
+        //heterogeneous lookup, key is hashed and compared as is
+        _rehash_step_if_needed();
+        return iterator(this, _find(key));
+    }
+
+    const_iterator find(const Key & key) const {
+        //a const lookup never advances an incremental rehash, so it changes
+        //nothing and may run alongside other const calls
+        return const_iterator(this, _find(key));
+    }
+
+    template <typename K>
+        requires _transparent
+    const_iterator find(const K & key) const {
+        return const_iterator(this, _find(key));
+    }
+
+    template <std::ranges::forward_range Keys, typename OutputIt>
+    OutputIt find_batch(const Keys & keys, OutputIt out) {
+        //looks up every key in keys and writes an iterator for each one
+        //(end() if it is missing) to out, in order
+        //the lookups are grouped and prefetched (see _batched), which pays off
+        //once the table no longer fits in cache
+        //returns out past the last iterator written
+        _batched(std::ranges::begin(keys), std::ranges::end(keys),
+                   [](const auto & key) -> const auto & { return key; },
+                   [&](size_type position, size_t code, const auto & key) {
+                       *out++ = iterator(this, _find_at(position, code, key));
+                   });
+        return out;
+    }
+
+    template <std::ranges::forward_range Values>
+    size_type insert_batch(Values && values) {
+        //inserts every element of values the way insert does (so an existing
+        //key gets its mapped value replaced), prefetched like find_batch
+        //a sized range grows the table once up front instead of along the way
+        //returns the number of new elements
+        if constexpr (std::ranges::sized_range<Values>) {
+            size_type count = _size + std::ranges::size(values);
+            if(!_incremental && _min_buckets_for(count) > _bucket_count) {
+                reserve(count);
             }
-            curr = curr->next;
         }
-        std::pair<Key, T> temp_val(key, T{});
-        HashNode* newNode = _insert_into_bucket(bucket_index, std::move(temp_val));
-        return newNode->val.second;
+
+        size_type inserted = 0;
+        _batched(std::ranges::begin(values), std::ranges::end(values),
+                   [](const auto & value) -> const auto & { return value.first; },
+                   [&](size_type, size_t code, auto && value) {
+                       inserted += _insert_unique(code, std::forward<decltype(value)>(value)).second;
+                   });
+        return inserted;
+    }
+
+    T& operator[](const Key & key) {
+        //finds node with given key and returns it's data
+        //if key is missing it is inserted with a value initialized mapped value,
+        //built directly inside the new node
+
+        _rehash_step_if_needed();
+        return (_try_emplace(key).first->val).second;
+    }
+
+    T& operator[](Key && key) {
+        _rehash_step_if_needed();
+        return (_try_emplace(std::move(key)).first->val).second;
+    }
+
+    template <typename K>
+        requires _transparent && std::is_constructible_v<Key, K>
+    T& operator[](K && key) {
+        //a Key is only built from key if it has to be inserted
+        _rehash_step_if_needed();
+        return (_try_emplace(std::forward<K>(key)).first->val).second;
     }
 
     iterator erase(iterator pos) {
-        //to remove element at pos, we need to find the bucket for the given item
-        //then traverse that bucket using a prev and curr pointer
-        // when we find the node, set prev.next to delete node's next
-        //if prev is nullptr, that means the delete node is the first node
-        //in that case we want to set the bucket's head to it's next node
+        //removes the element at pos and returns an iterator to the element after it
 
         if(!pos._ptr) {
             return pos;
         }
 
-        size_type bucket_index = _bucket(*pos);
-        HashNode* prev = nullptr;
-        HashNode* curr = _buckets[bucket_index];
-
-        while(curr) {
-            if((curr->val).first == ((pos._ptr)->val).first) {
-
-                if(!prev) {
-                    _buckets[bucket_index] = curr->next;
-                } else {
-                    prev->next = curr->next;
-                }
-                _size--;
-                ++pos;
-                if(curr == _head) {
-                    _head = pos._ptr;
-                }
-                delete curr;
-                return pos;
-            }
-            prev = curr;
-            curr = curr->next;
-        }
-        
-        return pos;
+        HashNode* next = _erase_node(pos._ptr);
+        return iterator(this, next);
     }
 
     size_type erase(const Key & key) {
         //removes element with given key and returns number of elements removed
-        //we first need to find the bucket index
-        //then we need to traverse the bucket with curr and prev pointer
+        //we first need to find the node with the given key
         //once we find the node, remove it and return 1
-        //if we traverse thru the whole bucket w/o finding it, return 0
+        //if the key is not in the map, return 0
 
-        size_type bucket_index = _bucket(key);
-        HashNode* prev = nullptr;
-        HashNode* curr = _buckets[bucket_index];
+        _rehash_step_if_needed();
+        HashNode* node = _find(key);
+        if(!node) {
+            return 0;
+        }
+        _erase_node(node);
+        return 1;
+    }
 
-        while(curr) {
-            if((curr->val).first == key) {
-                if(!prev) {
-                    _buckets[bucket_index] = curr->next;
+    template <typename K>
+        requires _transparent && (!std::is_convertible_v<K, iterator>)
+    size_type erase(const K & key) {
+        //heterogeneous erase
+        _rehash_step_if_needed();
+        HashNode* node = _find(key);
+        if(!node) {
+            return 0;
+        }
+        _erase_node(node);
+        return 1;
+    }
+
+    node_type extract(iterator pos) {
+        //takes the element at pos out of the map, still in its node, which the
+        //returned handle now owns (see node_type)
+        if(!pos._ptr) {
+            return node_type();
+        }
+        return node_type(_detach_node(pos._ptr), _node_alloc);
+    }
+
+    node_type extract(const Key & key) {
+        //same as above for the element with key, an empty handle if there is none
+        _rehash_step_if_needed();
+        HashNode* node = _find(key);
+        if(!node) {
+            return node_type();
+        }
+        return node_type(_detach_node(node), _node_alloc);
+    }
+
+    template <typename K>
+        requires _transparent && (!std::is_convertible_v<K, iterator>)
+    node_type extract(const K & key) {
+        _rehash_step_if_needed();
+        HashNode* node = _find(key);
+        if(!node) {
+            return node_type();
+        }
+        return node_type(_detach_node(node), _node_alloc);
+    }
+
+    insert_return_type insert(node_type && nh) {
+        //links the element held by nh into the map, unless its key is already
+        //here, in which case nh keeps it and is handed back in the result
+        //the node itself is relinked when our allocator can free it, otherwise
+        //(e.g. a PoolAllocator of another map) the element is moved into a new node
+        if(nh.empty()) {
+            return {end(), false, node_type()};
+        }
+
+        _rehash_step_if_needed();
+        HashNode* node = nh._node;
+        size_t code = _adopted_code(node, true);
+        if(HashNode* curr = _find(code, (node->val).first)) {
+            return {iterator(this, curr), false, std::move(nh)};
+        }
+        if(_shares_allocator(*nh._alloc)) {
+            nh._release();
+        } else {
+            node = _new_node(std::move(node->val));
+            nh._destroy();
+        }
+        return {iterator(this, _link(code, node)), true, node_type()};
+    }
+
+    void merge(UnorderedMap & source) {
+        //moves every element of source whose key isn't in this map over here,
+        //appended in source's order, the others stay in source
+        //the nodes are relinked, nothing is allocated, copied or (with a
+        //stateless hasher) rehashed, except that elements in source's inline
+        //slots, or from an allocator ours can't free, move into new nodes
+        if(&source == this) {
+            return;
+        }
+
+        _rehash_step_if_needed();
+        bool relink = _shares_allocator(source._node_alloc);
+        bool cached = !source._small();
+        for(HashNode* curr = source._head; curr; ) {
+            HashNode* next = curr->list_next;
+            size_t code = _adopted_code(curr, cached);
+            if(!_find(code, (curr->val).first)) {
+                HashNode* node = curr;
+                if(relink && !source._is_inline(curr)) {
+                    source._unlink_node(curr);
                 } else {
-                    prev->next = curr->next;
+                    node = _new_node(std::move(curr->val));
+                    source._erase_node(curr);
                 }
-                _size--;
-                delete curr;
-                return 1;
+                _link(code, node);
             }
-            prev = curr;
-            curr = curr->next;
-
+            curr = next;
         }
-        return 0;
+    }
+
+    void merge(UnorderedMap && source) {
+        merge(source);
+    }
+
+    //binary snapshots, see snapshot.h for the format
+    //they keep the hash codes, so loading one calls the hasher once (to
+    //check the codes still hold) instead of once per key, and trivially
+    //copyable keys and values are copied in blocks
+
+    void serialize(std::ostream & os) const {
+        //writes a snapshot of the map to os, throws std::runtime_error if os fails
+        snapshot_stream_writer out(os);
+        _write_snapshot(out);
+    }
+
+    std::vector<char> serialize() const {
+        //returns a snapshot of the map
+        std::vector<char> buffer;
+        snapshot_buffer_writer out(buffer);
+        _write_snapshot(out);
+        return buffer;
+    }
+
+    void deserialize(std::istream & is) {
+        //replaces the map's elements with the ones of a snapshot read from is
+        //throws std::runtime_error if is holds no snapshot of this map type or
+        //ends early (also when a corrupt size or length claims more than is
+        //there), leaving the elements read up to then
+        snapshot_stream_reader in(is);
+        _read_snapshot(in);
+    }
+
+    void deserialize(const char * data, size_type size) {
+        //the same from a snapshot in memory, e.g. one returned by serialize()
+        snapshot_buffer_reader in(data, size);
+        _read_snapshot(in);
     }
 
     template<typename KK, typename VV>
@@ -708,10 +2281,15 @@ void print_map(const UnorderedMap<K, V> & map, std::ostream & os = std::cout) {
     using size_type = typename UnorderedMap<K, V>::size_type;
     using HashNode = typename UnorderedMap<K, V>::HashNode;
 
-    for(size_type bucket = 0; bucket < map.bucket_count(); bucket++) {
-        os << bucket << ": ";
+    //buckets of an unfinished incremental rehash are printed after the current ones
+    for(size_type position = 0; position < map._end_position(); position++) {
+        if(position < map.bucket_count()) {
+            os << position << ": ";
+        } else {
+            os << "old " << position - map.bucket_count() << ": ";
+        }
 
-        HashNode const * node = map._buckets[bucket];
+        HashNode const * node = map._slot(position);
 
         while(node) {
             os << "(" << node->val.first << ", " << node->val.second << ") ";
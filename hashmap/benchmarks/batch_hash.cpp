@@ -0,0 +1,75 @@
+// fnv1a_hash and polynomial_rolling_hash one key at a time against hash_batch
+// on short keys, checking that both produce the same hash codes.
+//
+// build (from hashmap/benchmarks), -march=native picks the widest SIMD available:
+//     g++ -std=c++20 -O2 -march=native batch_hash.cpp ../hash_functions.cpp -o batch_hash
+// usage:
+//     ./batch_hash [n_keys] [max_key_length]
+
+#include "../hash_functions.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps the hash codes from being optimized away
+static volatile uint64_t sink;
+
+template <typename Hash>
+static void compare(char const * name, std::vector<std::string_view> const & keys) {
+    Hash hash;
+    std::vector<size_t> scalar(keys.size()), batched(keys.size());
+
+    auto start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++)
+        scalar[i] = hash(keys[i]);
+    auto middle = Clock::now();
+    hash.hash_batch(keys.data(), keys.size(), batched.data());
+    auto stop = Clock::now();
+
+    size_t mismatches = 0;
+    for(size_t i = 0; i < keys.size(); i++)
+        mismatches += scalar[i] != batched[i];
+    sink = scalar.back() + batched.back();
+
+    double scalar_ns = std::chrono::duration<double, std::nano>(middle - start).count() / keys.size();
+    double batched_ns = std::chrono::duration<double, std::nano>(stop - middle).count() / keys.size();
+    std::cout << std::fixed << std::setprecision(2)
+              << "    " << std::left << std::setw(12) << name << std::right
+              << std::setw(10) << scalar_ns << " ns"
+              << std::setw(10) << batched_ns << " ns"
+              << std::setw(9) << scalar_ns / batched_ns << "x"
+              << "   mismatches: " << mismatches
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    size_t max_length = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 24;
+
+    //every byte value appears, so the sign extension of chars >= 0x80 is covered
+    std::mt19937_64 generator(9);
+    std::vector<std::string> storage(n);
+    for(std::string & key : storage) {
+        key.resize(1 + generator() % max_length);
+        for(char & c : key)
+            c = static_cast<char>(generator());
+    }
+    std::vector<std::string_view> keys(storage.begin(), storage.end());
+
+    std::cout << "keys: " << n << ", 1 to " << max_length << " bytes (per key)" << std::endl;
+    std::cout << "    " << std::setw(12) << "" << std::setw(13) << "scalar"
+              << std::setw(13) << "hash_batch" << std::setw(10) << "speedup" << std::endl;
+    compare<fnv1a_hash>("fnv1a", keys);
+    compare<polynomial_rolling_hash>("polynomial", keys);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+// find_batch / insert_batch against one find / insert per key, on a table far
+// larger than the last level cache so nearly every bucket slot and node is a miss.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 batched_lookup.cpp ../primes.cpp -o batched_lookup
+// usage:
+//     ./batched_lookup [n_keys] [n_lookups]
+
+#include "../UnorderedMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Map = UnorderedMap<uint64_t, uint64_t>;
+
+//keeps lookups from being optimized away
+static volatile uint64_t sink;
+
+template <typename F>
+static double time_per(size_t operations, F && body) {
+    //returns nanoseconds per operation
+    auto start = Clock::now();
+    body();
+    auto stop = Clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / operations;
+}
+
+template <typename F>
+static double best_of(size_t runs, size_t operations, F && body) {
+    //the fastest of several runs, to filter out noise from other processes
+    double best = time_per(operations, body);
+    for(size_t r = 1; r < runs; r++)
+        best = std::min(best, time_per(operations, body));
+    return best;
+}
+
+static void print_row(char const * name, double scalar, double batched) {
+    std::cout << std::fixed << std::setprecision(1)
+              << "    " << std::left << std::setw(10) << name << std::right
+              << std::setw(10) << scalar << " ns"
+              << std::setw(10) << batched << " ns"
+              << std::setw(9) << std::setprecision(2) << scalar / batched << "x"
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 8'000'000;
+    size_t n_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10'000'000;
+
+    std::mt19937_64 generator(5);
+    std::vector<std::pair<const uint64_t, uint64_t>> values;
+    values.reserve(n);
+    for(size_t i = 0; i < n; i++)
+        values.emplace_back(generator(), i);
+
+    //the lookups hit in random order, so consecutive keys share no cache lines
+    std::vector<uint64_t> keys(n_lookups);
+    for(uint64_t & key : keys)
+        key = values[generator() % n].first;
+
+    std::cout << "keys: " << n << ", lookups: " << n_lookups << std::endl;
+    std::cout << "    " << std::setw(10) << "" << std::setw(13) << "scalar"
+              << std::setw(13) << "batched" << std::setw(10) << "speedup" << std::endl;
+
+    Map scalar_map(n);
+    double scalar_insert = time_per(n, [&] {
+        for(auto const & value : values)
+            scalar_map.insert(value);
+    });
+    Map batched_map(n);
+    double batched_insert = time_per(n, [&] {
+        batched_map.insert_batch(values);
+    });
+    print_row("insert", scalar_insert, batched_insert);
+
+    //results are collected a block at a time and then consumed, as a join
+    //would, the same way for both so only the lookups differ
+    std::vector<Map::iterator> found(4096);
+    double scalar_find = best_of(5, n_lookups, [&] {
+        uint64_t sum = 0;
+        for(size_t start = 0; start < keys.size(); start += found.size()) {
+            size_t count = std::min(found.size(), keys.size() - start);
+            for(size_t i = 0; i < count; i++)
+                found[i] = scalar_map.find(keys[start + i]);
+            for(size_t i = 0; i < count; i++)
+                sum += found[i]->second;
+        }
+        sink = sum;
+    });
+    double batched_find = best_of(5, n_lookups, [&] {
+        uint64_t sum = 0;
+        for(size_t start = 0; start < keys.size(); start += found.size()) {
+            size_t count = std::min(found.size(), keys.size() - start);
+            std::vector<uint64_t>::const_iterator first = keys.begin() + start;
+            scalar_map.find_batch(std::ranges::subrange(first, first + count), found.begin());
+            for(size_t i = 0; i < count; i++)
+                sum += found[i]->second;
+        }
+        sink = sum;
+    });
+    print_row("find", scalar_find, batched_find);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Throughput of ConcurrentUnorderedMap against an UnorderedMap behind one
+// global mutex, for 1 to 64 threads running a read-mostly mix
+// (90% find_and_apply, 9% insert_or_update, 1% erase) over a shared key set,
+// half of which is present at the start.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 -pthread concurrent_scaling.cpp ../primes.cpp -o concurrent_scaling
+// usage:
+//     ./concurrent_scaling [n_keys] [ops_per_thread] [shards]
+
+#include "../ConcurrentUnorderedMap.h"
+#include "../UnorderedMap.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps lookups from being optimized away
+static std::atomic<uint64_t> sink;
+
+//the baseline: what the workers do today
+struct GlobalLockMap {
+    std::mutex lock;
+    UnorderedMap<uint64_t, uint64_t> map;
+
+    GlobalLockMap(size_t n) : map(n) {}
+
+    bool insert_or_update(uint64_t key, uint64_t value) {
+        std::lock_guard guard(lock);
+        return map.insert_or_assign(key, value).second;
+    }
+
+    template <typename F>
+    bool find_and_apply(uint64_t key, F && apply) {
+        std::lock_guard guard(lock);
+        auto it = map.find(key);
+        if(it == map.end()) {
+            return false;
+        }
+        apply(it->second);
+        return true;
+    }
+
+    bool erase(uint64_t key) {
+        std::lock_guard guard(lock);
+        return map.erase(key) != 0;
+    }
+};
+
+template <typename Map>
+static double run(Map & map, std::vector<uint64_t> const & keys, size_t threads, size_t ops) {
+    //returns millions of operations per second over all threads
+    std::vector<std::thread> workers;
+    std::atomic<bool> go = false;
+
+    for(size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 generator(t + 1);
+            uint64_t sum = 0;
+            while(!go.load(std::memory_order_acquire)) {}
+            for(size_t i = 0; i < ops; i++) {
+                uint64_t key = keys[generator() % keys.size()];
+                uint64_t op = generator() % 100;
+                if(op < 90) {
+                    map.find_and_apply(key, [&](const uint64_t & value) { sum += value; });
+                } else if(op < 99) {
+                    map.insert_or_update(key, i);
+                } else {
+                    map.erase(key);
+                }
+            }
+            sink += sum;
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for(std::thread & worker : workers)
+        worker.join();
+    auto stop = Clock::now();
+
+    return threads * ops / std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+int main(int argc, char ** argv) {
+    size_t n_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    size_t shards = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+
+    std::cout << "keys: " << n_keys << ", ops per thread: " << ops
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(18) << "global mutex"
+              << std::setw(18) << "sharded"
+              << "   (million ops/s)" << std::endl;
+
+    //random keys, since std::hash<uint64_t> would give small sequential keys
+    //a collision free table that no real key set gets
+    std::mt19937_64 generator(3);
+    std::vector<uint64_t> keys(n_keys);
+    for(uint64_t & key : keys)
+        key = generator();
+
+    for(size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        GlobalLockMap global(n_keys);
+        ConcurrentUnorderedMap<uint64_t, uint64_t> sharded(n_keys, shards);
+        for(size_t i = 0; i < n_keys; i += 2) {
+            global.insert_or_update(keys[i], i);
+            sharded.insert_or_update(keys[i], i);
+        }
+
+        double global_rate = run(global, keys, threads, ops);
+        double sharded_rate = run(sharded, keys, threads, ops);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << threads
+                  << std::setw(18) << global_rate
+                  << std::setw(18) << sharded_rate
+                  << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Growing an UnorderedMap<uint64_t, uint64_t> from an empty table to n keys
+// with each bucket policy: how many times it rehashed, the bucket count it
+// ended at, the insert time, and the find time on the grown table.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 growth_policies.cpp ../primes.cpp -o growth_policies
+// usage:
+//     ./growth_policies [n_keys] [n_lookups]
+
+#include "../UnorderedMap.h"
+#include "../bucket_policies.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps lookups from being optimized away
+static volatile uint64_t sink;
+
+template <typename Policy>
+static void run(char const * name, std::vector<uint64_t> const & keys, std::vector<uint64_t> const & lookups) {
+    UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                 std::allocator<std::pair<const uint64_t, uint64_t>>, Policy> map(1);
+
+    size_t rehashes = 0;
+    size_t buckets = map.bucket_count();
+    auto start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++) {
+        map.insert({keys[i], i});
+        if(map.bucket_count() != buckets) {
+            buckets = map.bucket_count();
+            rehashes++;
+        }
+    }
+    auto inserted = Clock::now();
+    uint64_t sum = 0;
+    for(uint64_t key : lookups)
+        sum += map.find(key)->second;
+    auto found = Clock::now();
+    sink = sum;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "    " << std::left << std::setw(20) << name << std::right
+              << std::setw(10) << rehashes
+              << std::setw(14) << map.bucket_count()
+              << std::setw(8) << map.load_factor()
+              << std::setw(12) << std::chrono::duration<double, std::milli>(inserted - start).count() << " ms"
+              << std::setw(10) << std::chrono::duration<double, std::nano>(found - inserted).count() / lookups.size()
+              << " ns" << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 3'000'000;
+    size_t n_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5'000'000;
+
+    //random keys, std::hash<uint64_t> is the identity
+    std::mt19937_64 generator(25);
+    std::vector<uint64_t> keys(n);
+    for(uint64_t & key : keys)
+        key = generator();
+    std::vector<uint64_t> lookups(n_lookups);
+    for(uint64_t & key : lookups)
+        key = keys[generator() % n];
+
+    std::cout << "keys: " << n << ", lookups: " << n_lookups << std::endl;
+    std::cout << "    " << std::left << std::setw(20) << "policy" << std::right
+              << std::setw(10) << "rehashes" << std::setw(14) << "buckets" << std::setw(8) << "load"
+              << std::setw(15) << "insert" << std::setw(13) << "find" << std::endl;
+    run<prime_modulo_policy>("prime modulo 2x", keys, lookups);
+    run<prime_reciprocal_policy>("prime reciprocal 2x", keys, lookups);
+    run<prime_one_and_a_half_policy>("prime reciprocal 1.5x", keys, lookups);
+    run<power_of_two_policy>("power of two", keys, lookups);
+    return 0;
+}
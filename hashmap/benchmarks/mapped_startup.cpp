@@ -0,0 +1,112 @@
+// Startup cost of a string -> int table: parsing it from a text file into an
+// UnorderedMap against opening the same table written by MappedUnorderedMap,
+// then the first (cold) and repeated (warm) lookups on each.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 mapped_startup.cpp ../primes.cpp -o mapped_startup
+// usage:
+//     ./mapped_startup [n_keys] [n_lookups] [directory]
+
+#include "../MappedUnorderedMap.h"
+#include "../UnorderedMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Map = UnorderedMap<std::string, int>;
+
+//keeps lookups from being optimized away
+static volatile int64_t sink;
+
+template <typename F>
+static double milliseconds(F && body) {
+    auto start = Clock::now();
+    body();
+    auto stop = Clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+static void print_row(char const * name, double text, double mapped) {
+    std::cout << std::fixed << std::setprecision(3)
+              << "    " << std::left << std::setw(16) << name << std::right
+              << std::setw(12) << text << " ms"
+              << std::setw(12) << mapped << " ms"
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    size_t n_lookups = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    std::filesystem::path directory = argc > 3 ? argv[3] : std::filesystem::temp_directory_path();
+    std::filesystem::path text_path = directory / "mapped_startup.txt";
+    std::filesystem::path mapped_path = directory / "mapped_startup.idx";
+
+    std::mt19937_64 generator(16);
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    {
+        std::ofstream text(text_path);
+        for(size_t i = 0; i < n; i++) {
+            keys.push_back("key-" + std::to_string(generator()));
+            text << keys.back() << ' ' << static_cast<int>(i) << '\n';
+        }
+    }
+    std::vector<std::string> lookups(n_lookups);
+    for(std::string & key : lookups)
+        key = keys[generator() % n];
+
+    Map map(16);
+    double parse = milliseconds([&] {
+        std::ifstream text(text_path);
+        std::string key;
+        int value;
+        while(text >> key >> value)
+            map.insert({key, value});
+    });
+    double write = milliseconds([&] {
+        MappedUnorderedMap<int>::write(map, mapped_path);
+    });
+
+    MappedUnorderedMap<int> mapped;
+    double open = milliseconds([&] {
+        mapped = MappedUnorderedMap<int>(mapped_path);
+    });
+
+    //the first pass over the mapped table faults its pages in (from the page
+    //cache here, the file was just written), the second runs on mapped pages
+    auto find_all = [&](auto && find) {
+        return milliseconds([&] {
+            int64_t sum = 0;
+            for(std::string const & key : lookups)
+                sum += find(key);
+            sink = sum;
+        });
+    };
+    auto text_find = [&](std::string const & key) { return map.find(key)->second; };
+    auto mapped_find = [&](std::string const & key) { return *mapped.find(key); };
+    double text_cold = find_all(text_find), mapped_cold = find_all(mapped_find);
+    double text_warm = find_all(text_find), mapped_warm = find_all(mapped_find);
+
+    std::cout << "keys: " << n << ", lookups: " << n_lookups
+              << ", file: " << mapped.file_size() / (1 << 20) << " MiB" << std::endl;
+    std::cout << "    " << std::setw(16) << "" << std::setw(15) << "text" << std::setw(15) << "mapped" << std::endl;
+    print_row("startup", parse, open);
+    print_row("first lookups", text_cold, mapped_cold);
+    print_row("warm lookups", text_warm, mapped_warm);
+    std::cout << "    (writing the mapped file took " << std::fixed << std::setprecision(1)
+              << write << " ms)" << std::endl;
+
+    std::filesystem::remove(text_path);
+    std::filesystem::remove(mapped_path);
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Building an UnorderedMap<std::string, int> from n (key, value) pairs: the
+// insert-one-at-a-time loop main.cpp uses, against the parallel_build
+// constructor on 1, 2, 4, ... threads (up to max_threads).
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 -pthread parallel_build.cpp ../primes.cpp -o parallel_build
+// usage:
+//     ./parallel_build [n_pairs] [max_threads]
+
+#include "../PoolAllocator.h"
+#include "../UnorderedMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Map = UnorderedMap<std::string, int>;
+using PoolMap = UnorderedMap<std::string, int, std::hash<std::string>, std::equal_to<std::string>,
+                             PoolAllocator<std::pair<const std::string, int>>>;
+
+template <typename F>
+static double seconds(F && body) {
+    auto start = Clock::now();
+    body();
+    auto stop = Clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+static void print_row(std::string const & name, double time, double serial) {
+    std::cout << std::fixed << std::setprecision(3)
+              << "    " << std::left << std::setw(24) << name << std::right
+              << std::setw(10) << time << " s"
+              << std::setw(9) << std::setprecision(2) << serial / time << "x"
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                  : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    //keys are drawn from 0.9 n values, so about 40% of the pairs repeat a key
+    //and the builds have duplicates to resolve
+    std::mt19937_64 generator(20);
+    std::vector<std::pair<std::string, int>> pairs;
+    pairs.reserve(n);
+    for(size_t i = 0; i < n; i++)
+        pairs.emplace_back("key-" + std::to_string(generator() % (n - n / 10 + 1)), static_cast<int>(i));
+
+    std::cout << "pairs: " << n << ", cores: " << std::thread::hardware_concurrency() << std::endl;
+
+    size_t size = 0;
+    double serial = seconds([&] {
+        Map map(30);
+        for(auto const & pair : pairs)
+            map.insert({pair.first, pair.second});
+        size = map.size();
+    });
+    std::cout << "    distinct keys: " << size << std::endl;
+    print_row("serial insert", serial, serial);
+
+    for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double time = seconds([&] {
+            Map map(parallel_build, pairs, threads);
+            size = map.size();
+        });
+        print_row("parallel_build " + std::to_string(threads), time, serial);
+    }
+    for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double time = seconds([&] {
+            PoolMap map(parallel_build, pairs, threads);
+            size = map.size();
+        });
+        print_row("  with pools " + std::to_string(threads), time, serial);
+    }
+
+    return 0;
+}
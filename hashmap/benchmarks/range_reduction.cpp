@@ -0,0 +1,132 @@
+// Cost of turning a hash code into a bucket index with each policy from
+// bucket_policies.h: first the reduction on its own, then successful finds
+// in UnorderedMaps of growing size, where cache misses gradually take over.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 range_reduction.cpp ../primes.cpp -o range_reduction
+// usage:
+//     ./range_reduction [reductions] [lookups_per_size]
+//
+// cycles are time stamp counter ticks (reference cycles) on x86 and are left
+// out elsewhere
+
+#include "../UnorderedMap.h"
+#include "../bucket_policies.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+//keeps results from being optimized away
+static volatile uint64_t sink;
+
+struct Cost {
+    double ns;
+    double cycles;
+};
+
+template <typename F>
+static Cost measure(size_t operations, F && body) {
+    auto start = Clock::now();
+#ifdef HAVE_RDTSC
+    uint64_t start_ticks = __rdtsc();
+#endif
+    body();
+#ifdef HAVE_RDTSC
+    uint64_t ticks = __rdtsc() - start_ticks;
+#else
+    uint64_t ticks = 0;
+#endif
+    auto stop = Clock::now();
+    return {std::chrono::duration<double, std::nano>(stop - start).count() / operations,
+            static_cast<double>(ticks) / operations};
+}
+
+template <typename Policy>
+static Cost reduce(std::vector<uint64_t> const & codes, size_t bucket_count) {
+    //reduces every code once, the indices are independent of each other
+    //so this is throughput rather than latency
+    Policy policy;
+    policy.reset(Policy::bucket_count_for(bucket_count));
+    uint64_t sum = 0;
+    Cost cost = measure(codes.size(), [&] {
+        for(uint64_t code : codes)
+            sum += policy.index(code);
+    });
+    sink = sum;
+    return cost;
+}
+
+template <typename Policy>
+static Cost lookups(std::vector<uint64_t> const & keys, size_t rounds) {
+    UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                 std::allocator<std::pair<const uint64_t, uint64_t>>, Policy> map(keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        map.insert({keys[i], i});
+
+    uint64_t sum = 0;
+    Cost cost = measure(keys.size() * rounds, [&] {
+        for(size_t r = 0; r < rounds; r++)
+            for(uint64_t key : keys)
+                sum += map.find(key)->second;
+    });
+    sink = sum;
+    return cost;
+}
+
+static void print_row(char const * name, Cost cost, Cost baseline) {
+    std::cout << std::fixed << std::setprecision(2)
+              << "    " << std::left << std::setw(18) << name << std::right
+              << std::setw(8) << cost.ns << " ns";
+#ifdef HAVE_RDTSC
+    std::cout << std::setw(8) << cost.cycles << " cycles"
+              << "  (saves " << std::setw(6) << baseline.cycles - cost.cycles << ")";
+#else
+    std::cout << "  (saves " << std::setw(6) << baseline.ns - cost.ns << " ns)";
+#endif
+    std::cout << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t reductions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50'000'000;
+    size_t lookups_per_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20'000'000;
+
+    //std::hash<uint64_t> is the identity, random keys keep the comparison fair
+    //to fastrange_policy, which only looks at the high bits
+    std::mt19937_64 generator(11);
+    std::vector<uint64_t> codes(reductions);
+    for(uint64_t & code : codes)
+        code = generator();
+
+    std::cout << "reduction only, per index:" << std::endl;
+    Cost modulo = reduce<prime_modulo_policy>(codes, 1'000'000);
+    print_row("prime modulo", modulo, modulo);
+    print_row("prime reciprocal", reduce<prime_reciprocal_policy>(codes, 1'000'000), modulo);
+    print_row("power of two", reduce<power_of_two_policy>(codes, 1'000'000), modulo);
+    print_row("fastrange", reduce<fastrange_policy>(codes, 1'000'000), modulo);
+
+    for(size_t n : {1'000, 64'000, 1'000'000}) {
+        std::vector<uint64_t> keys(codes.begin(), codes.begin() + std::min(n, codes.size()));
+        size_t rounds = std::max<size_t>(lookups_per_size / keys.size(), 1);
+
+        std::cout << "find, " << keys.size() << " keys:" << std::endl;
+        Cost baseline = lookups<prime_modulo_policy>(keys, rounds);
+        print_row("prime modulo", baseline, baseline);
+        print_row("prime reciprocal", lookups<prime_reciprocal_policy>(keys, rounds), baseline);
+        print_row("power of two", lookups<power_of_two_policy>(keys, rounds), baseline);
+        print_row("fastrange", lookups<fastrange_policy>(keys, rounds), baseline);
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Read throughput of ReadMostlyMap against an UnorderedMap behind one
+// shared_mutex and against ConcurrentUnorderedMap, for 1 to 64 threads
+// running 99% find_and_apply and 1% insert_or_update over a shared key set
+// that is fully present at the start.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 -pthread read_mostly_scaling.cpp ../primes.cpp -o read_mostly_scaling
+// usage:
+//     ./read_mostly_scaling [n_keys] [ops_per_thread]
+
+#include "../ConcurrentUnorderedMap.h"
+#include "../ReadMostlyMap.h"
+#include "../UnorderedMap.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps lookups from being optimized away
+static std::atomic<uint64_t> sink;
+
+//the baseline: readers share one lock, whose cache line every read writes
+struct SharedLockMap {
+    mutable std::shared_mutex lock;
+    UnorderedMap<uint64_t, uint64_t> map;
+
+    SharedLockMap(size_t n) : map(n) {}
+
+    bool insert_or_update(uint64_t key, uint64_t value) {
+        std::unique_lock guard(lock);
+        return map.insert_or_assign(key, value).second;
+    }
+
+    template <typename F>
+    bool find_and_apply(uint64_t key, F && apply) const {
+        std::shared_lock guard(lock);
+        auto it = map.find(key);
+        if(it == map.cend()) {
+            return false;
+        }
+        apply(it->second);
+        return true;
+    }
+};
+
+template <typename Map>
+static double run(Map & map, std::vector<uint64_t> const & keys, size_t threads, size_t ops) {
+    //returns millions of lookups per second over all threads
+    std::vector<std::thread> workers;
+    std::atomic<bool> go = false;
+    std::atomic<size_t> reads = 0;
+
+    for(size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 generator(t + 1);
+            uint64_t sum = 0;
+            size_t found = 0;
+            while(!go.load(std::memory_order_acquire)) {}
+            for(size_t i = 0; i < ops; i++) {
+                uint64_t key = keys[generator() % keys.size()];
+                if(generator() % 100 != 0) {
+                    map.find_and_apply(key, [&](const uint64_t & value) { sum += value; });
+                    found++;
+                } else {
+                    map.insert_or_update(key, i);
+                }
+            }
+            sink += sum;
+            reads += found;
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for(std::thread & worker : workers)
+        worker.join();
+    auto stop = Clock::now();
+
+    return reads / std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+int main(int argc, char ** argv) {
+    size_t n_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+
+    std::cout << "keys: " << n_keys << ", ops per thread: " << ops
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(18) << "shared_mutex"
+              << std::setw(18) << "sharded"
+              << std::setw(18) << "read-mostly"
+              << "   (million reads/s)" << std::endl;
+
+    //random keys, since std::hash<uint64_t> would give small sequential keys
+    //a collision free table that no real key set gets
+    std::mt19937_64 generator(21);
+    std::vector<uint64_t> keys(n_keys);
+    for(uint64_t & key : keys)
+        key = generator();
+
+    for(size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        SharedLockMap shared(n_keys);
+        ConcurrentUnorderedMap<uint64_t, uint64_t> sharded(n_keys);
+        ReadMostlyMap<uint64_t, uint64_t> read_mostly(n_keys);
+        for(size_t i = 0; i < n_keys; i++) {
+            shared.insert_or_update(keys[i], i);
+            sharded.insert_or_update(keys[i], i);
+            read_mostly.insert_or_update(keys[i], i);
+        }
+
+        double shared_rate = run(shared, keys, threads, ops);
+        double sharded_rate = run(sharded, keys, threads, ops);
+        double read_mostly_rate = run(read_mostly, keys, threads, ops);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << threads
+                  << std::setw(18) << shared_rate
+                  << std::setw(18) << sharded_rate
+                  << std::setw(18) << read_mostly_rate
+                  << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+}
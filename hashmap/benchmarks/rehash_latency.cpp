@@ -0,0 +1,79 @@
+// Per-insert latency of UnorderedMap with one-shot vs incremental rehashing.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 rehash_latency.cpp ../primes.cpp -o rehash_latency
+// usage:
+//     ./rehash_latency [n_inserts]
+
+#include "../UnorderedMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static std::vector<double> time_inserts(std::vector<uint64_t> const & keys, bool incremental) {
+    //times every insert on its own so the rehash stalls show up in the tail
+    UnorderedMap<uint64_t, uint64_t> map(8);
+    map.incremental_rehash(incremental);
+
+    std::vector<double> latencies(keys.size());
+    for(size_t i = 0; i < keys.size(); i++) {
+        auto start = Clock::now();
+        map.insert({keys[i], i});
+        auto stop = Clock::now();
+        latencies[i] = std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+    return latencies;
+}
+
+static void report(char const * label, std::vector<double> latencies) {
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&](double p) {
+        size_t index = static_cast<size_t>(p * (latencies.size() - 1));
+        return latencies[index];
+    };
+
+    double total = 0;
+    for(double latency : latencies)
+        total += latency;
+
+    std::cout << std::setw(12) << label
+              << std::fixed << std::setprecision(0)
+              << std::setw(10) << percentile(0.50)
+              << std::setw(10) << percentile(0.99)
+              << std::setw(10) << percentile(0.999)
+              << std::setw(14) << latencies.back()
+              << std::setw(10) << std::setprecision(1) << total / 1e6
+              << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5'000'000;
+
+    std::mt19937_64 generator(42);
+    std::vector<uint64_t> keys(n);
+    for(uint64_t & key : keys)
+        key = generator();
+
+    std::cout << "inserts: " << n << " (latencies in ns, total in ms)" << std::endl;
+    std::cout << std::setw(12) << "mode"
+              << std::setw(10) << "p50"
+              << std::setw(10) << "p99"
+              << std::setw(10) << "p999"
+              << std::setw(14) << "max"
+              << std::setw(10) << "total"
+              << std::endl;
+
+    report("one-shot", time_inserts(keys, false));
+    report("incremental", time_inserts(keys, true));
+
+    return 0;
+}
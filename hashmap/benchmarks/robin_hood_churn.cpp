@@ -0,0 +1,109 @@
+// Sustained insert/erase churn on RobinHoodMap, FlatUnorderedMap and UnorderedMap,
+// with the Robin Hood probe length distribution after every round.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 robin_hood_churn.cpp ../primes.cpp -o robin_hood_churn
+// usage:
+//     ./robin_hood_churn [n_live_keys] [rounds]
+
+#include "../FlatUnorderedMap.h"
+#include "../RobinHoodMap.h"
+#include "../UnorderedMap.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps lookups from being optimized away
+static volatile uint64_t sink;
+
+//every round erases and re-inserts as many keys as the map holds
+template <typename Map>
+struct Churn {
+    Map map;
+    std::vector<uint64_t> live;
+    std::mt19937_64 generator;
+
+    Churn(size_t n) : map(n), generator(7) {
+        for(size_t i = 0; i < n; i++) {
+            live.push_back(generator());
+            map.insert({live.back(), i});
+        }
+    }
+
+    double round() {
+        //returns nanoseconds per erase + insert pair
+        size_t n = live.size();
+        auto start = Clock::now();
+        for(size_t i = 0; i < n; i++) {
+            size_t victim = generator() % n;
+            map.erase(live[victim]);
+            live[victim] = generator();
+            map.insert({live[victim], i});
+        }
+        auto stop = Clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count() / n;
+    }
+
+    double lookups() {
+        //returns nanoseconds per successful find
+        uint64_t sum = 0;
+        auto start = Clock::now();
+        for(uint64_t key : live)
+            sum += map.find(key)->second;
+        auto stop = Clock::now();
+        sink = sum;
+        return std::chrono::duration<double, std::nano>(stop - start).count() / live.size();
+    }
+};
+
+static void print_histogram(std::vector<size_t> const & histogram, size_t size) {
+    double mean = 0;
+    for(size_t d = 0; d < histogram.size(); d++)
+        mean += (d + 1) * static_cast<double>(histogram[d]);
+    mean /= size;
+
+    std::cout << "    probe lengths (mean " << std::setprecision(3) << mean
+              << ", max " << histogram.size() << "):";
+    for(size_t d = 0; d < histogram.size(); d++)
+        std::cout << ' ' << d + 1 << ':' << std::fixed << std::setprecision(1)
+                  << 100.0 * histogram[d] / size << '%' << std::defaultfloat;
+    std::cout << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+
+    Churn<RobinHoodMap<uint64_t, uint64_t>> robin_hood(n);
+    Churn<FlatUnorderedMap<uint64_t, uint64_t>> flat(n);
+    Churn<UnorderedMap<uint64_t, uint64_t>> chained(n);
+
+    std::cout << "live keys: " << n << " (ns per erase+insert / per find)" << std::endl;
+    std::cout << std::setw(8) << "round"
+              << std::setw(20) << "robin hood"
+              << std::setw(20) << "flat (tombstones)"
+              << std::setw(20) << "chained"
+              << std::endl;
+
+    for(size_t r = 1; r <= rounds; r++) {
+        double rh = robin_hood.round(), fl = flat.round(), ch = chained.round();
+        double rh_find = robin_hood.lookups(), fl_find = flat.lookups(), ch_find = chained.lookups();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(8) << r
+                  << std::setw(12) << rh << " / " << std::setw(5) << rh_find
+                  << std::setw(12) << fl << " / " << std::setw(5) << fl_find
+                  << std::setw(12) << ch << " / " << std::setw(5) << ch_find
+                  << std::defaultfloat << std::endl;
+        print_histogram(robin_hood.map.probe_histogram(), robin_hood.map.size());
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Checkpointing an UnorderedMap: writing it out with print_map and parsing
+// the text back against serialize / deserialize, to a file and to memory,
+// for string -> int and uint64_t -> uint64_t maps (the second takes the
+// block copy path).
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 snapshot.cpp ../primes.cpp -o snapshot
+// usage:
+//     ./snapshot [n_keys] [directory]
+
+#include "../UnorderedMap.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+static double milliseconds(F && body) {
+    auto start = Clock::now();
+    body();
+    auto stop = Clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+static void print_row(char const * name, double save, double load) {
+    std::cout << std::fixed << std::setprecision(1)
+              << "    " << std::left << std::setw(22) << name << std::right
+              << std::setw(12) << save << " ms"
+              << std::setw(12) << load << " ms"
+              << std::defaultfloat << std::endl;
+}
+
+template <typename Map, typename Parse>
+static void run(char const * title, Map const & map, std::filesystem::path const & directory, Parse parse) {
+    std::filesystem::path text_path = directory / "snapshot.txt";
+    std::filesystem::path binary_path = directory / "snapshot.bin";
+
+    std::cout << title << ", " << map.size() << " keys" << std::endl;
+    std::cout << "    " << std::setw(22) << "" << std::setw(15) << "save" << std::setw(15) << "load" << std::endl;
+
+    double text_save = milliseconds([&] {
+        std::ofstream text(text_path);
+        print_map(map, text);
+    });
+    double text_load = milliseconds([&] {
+        Map loaded(16);
+        std::ifstream text(text_path);
+        parse(text, loaded);
+    });
+    print_row("print_map / parse", text_save, text_load);
+
+    double file_save = milliseconds([&] {
+        std::ofstream binary(binary_path, std::ios::binary);
+        map.serialize(binary);
+    });
+    double file_load = milliseconds([&] {
+        Map loaded(16);
+        std::ifstream binary(binary_path, std::ios::binary);
+        loaded.deserialize(binary);
+    });
+    print_row("serialize, file", file_save, file_load);
+
+    std::vector<char> buffer;
+    double buffer_save = milliseconds([&] {
+        buffer = map.serialize();
+    });
+    double buffer_load = milliseconds([&] {
+        Map loaded(16);
+        loaded.deserialize(buffer.data(), buffer.size());
+    });
+    print_row("serialize, buffer", buffer_save, buffer_load);
+    std::cout << "    (text " << std::filesystem::file_size(text_path) / (1 << 20) << " MiB, binary "
+              << buffer.size() / (1 << 20) << " MiB)" << std::endl;
+
+    std::filesystem::remove(text_path);
+    std::filesystem::remove(binary_path);
+}
+
+template <typename Map>
+static void parse_buckets(std::istream & text, Map & map) {
+    //reads print_map's "index: (key, value) (key, value) ..." lines back
+    std::string line;
+    while(std::getline(text, line)) {
+        size_t open = line.find('(');
+        while(open != std::string::npos) {
+            size_t comma = line.find(", ", open);
+            size_t close = line.find(')', comma);
+            std::istringstream key(line.substr(open + 1, comma - open - 1));
+            std::istringstream value(line.substr(comma + 2, close - comma - 2));
+            typename Map::key_type k;
+            typename Map::mapped_type v;
+            key >> k;
+            value >> v;
+            map.insert({k, v});
+            open = line.find('(', close);
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::filesystem::path directory = argc > 2 ? argv[2] : std::filesystem::temp_directory_path();
+
+    std::mt19937_64 generator(24);
+    UnorderedMap<std::string, int> strings(16);
+    UnorderedMap<uint64_t, uint64_t> integers(16);
+    for(size_t i = 0; i < n; i++) {
+        strings.insert({"key-" + std::to_string(generator()), static_cast<int>(i)});
+        integers.insert({generator(), i});
+    }
+
+    run("std::string -> int", strings, directory, parse_buckets<UnorderedMap<std::string, int>>);
+    run("uint64_t -> uint64_t", integers, directory, parse_buckets<UnorderedMap<uint64_t, uint64_t>>);
+    return 0;
+}
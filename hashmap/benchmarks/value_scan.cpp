@@ -0,0 +1,111 @@
+// Full scans over the values of a string -> int map (sum, min/max, count of
+// values above a threshold): iterating UnorderedMap's nodes against
+// SoAUnorderedMap's for_each_value over its dense value array.
+//
+// build (from hashmap/benchmarks):
+//     g++ -std=c++20 -O2 -march=native value_scan.cpp ../primes.cpp -o value_scan
+// usage:
+//     ./value_scan [n_keys] [n_scans]
+
+#include "../SoAUnorderedMap.h"
+#include "../UnorderedMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+//keeps scans from being optimized away
+static volatile int64_t sink;
+
+template <typename F>
+static double milliseconds_per_scan(size_t scans, F && scan) {
+    auto start = Clock::now();
+    int64_t total = 0;
+    for(size_t i = 0; i < scans; i++)
+        total += scan();
+    auto stop = Clock::now();
+    sink = total;
+    return std::chrono::duration<double, std::milli>(stop - start).count() / scans;
+}
+
+static void print_row(char const * name, double nodes, double dense) {
+    std::cout << std::fixed << std::setprecision(3)
+              << "    " << std::left << std::setw(12) << name << std::right
+              << std::setw(12) << nodes << " ms"
+              << std::setw(12) << dense << " ms"
+              << std::setw(9) << std::setprecision(1) << nodes / dense << "x"
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t scans = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+    UnorderedMap<std::string, int> nodes(16);
+    SoAUnorderedMap<std::string, int> dense(16);
+    std::mt19937_64 generator(23);
+    for(size_t i = 0; i < n; i++) {
+        std::string key = "key-" + std::to_string(generator());
+        int value = static_cast<int>(generator() % 1000);
+        nodes.insert({key, value});
+        dense.insert({key, value});
+    }
+
+    std::cout << "keys: " << nodes.size() << ", scans: " << scans << std::endl;
+    std::cout << "    " << std::setw(12) << "" << std::setw(15) << "UnorderedMap"
+              << std::setw(15) << "SoA" << std::endl;
+
+    double nodes_sum = milliseconds_per_scan(scans, [&] {
+        int64_t sum = 0;
+        for(auto it = nodes.cbegin(); it != nodes.cend(); ++it)
+            sum += it->second;
+        return sum;
+    });
+    double dense_sum = milliseconds_per_scan(scans, [&] {
+        int64_t sum = 0;
+        dense.for_each_value([&](int value) { sum += value; });
+        return sum;
+    });
+    print_row("sum", nodes_sum, dense_sum);
+
+    double nodes_minmax = milliseconds_per_scan(scans, [&] {
+        int low = std::numeric_limits<int>::max(), high = std::numeric_limits<int>::min();
+        for(auto it = nodes.cbegin(); it != nodes.cend(); ++it) {
+            low = std::min(low, it->second);
+            high = std::max(high, it->second);
+        }
+        return int64_t(high) - low;
+    });
+    double dense_minmax = milliseconds_per_scan(scans, [&] {
+        int low = std::numeric_limits<int>::max(), high = std::numeric_limits<int>::min();
+        dense.for_each_value([&](int value) {
+            low = std::min(low, value);
+            high = std::max(high, value);
+        });
+        return int64_t(high) - low;
+    });
+    print_row("min/max", nodes_minmax, dense_minmax);
+
+    double nodes_filter = milliseconds_per_scan(scans, [&] {
+        int64_t count = 0;
+        for(auto it = nodes.cbegin(); it != nodes.cend(); ++it)
+            count += it->second > 900;
+        return count;
+    });
+    double dense_filter = milliseconds_per_scan(scans, [&] {
+        int64_t count = 0;
+        dense.for_each_value([&](int value) { count += value > 900; });
+        return count;
+    });
+    print_row("count > 900", nodes_filter, dense_filter);
+
+    return 0;
+}
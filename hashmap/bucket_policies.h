@@ -0,0 +1,136 @@
+#pragma once
+
+#include <bit>      // std::bit_ceil, std::countr_zero
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+
+#include "primes.h"
+
+/*
+    Bucket policies decide how many buckets a table may have and how a hash
+    code is reduced to a bucket index. UnorderedMap takes one as its
+    RangePolicy template parameter; every policy provides
+
+        static size_t bucket_count_for(size_t n)
+            the smallest bucket count this policy can use that is >= n;
+            a map grows to bucket_count_for(bucket_count() + 1), so the
+            spacing of the counts a policy allows is its growth factor
+
+        void reset(size_t bucket_count)
+            called whenever the table switches to bucket_count buckets,
+            so anything the reduction needs can be computed once up front
+
+        size_t index(size_t code) const
+            the bucket for hash code, in [0, bucket_count)
+*/
+
+//hash_code % bucket_count with prime bucket counts from the Growth ladder
+//(see primes.h), a 64-bit division per index
+template <prime_growth Growth = prime_growth::doubling>
+struct basic_prime_modulo_policy {
+    size_t _bucket_count = 1;
+
+    static size_t bucket_count_for(size_t n) {
+        return prime_step_for(n, Growth).prime;
+    }
+
+    void reset(size_t bucket_count) {
+        _bucket_count = bucket_count;
+    }
+
+    size_t index(size_t code) const {
+        return code % _bucket_count;
+    }
+};
+
+//the same result as basic_prime_modulo_policy, but the division is replaced
+//by multiplications with a 128-bit fixed point reciprocal of the prime
+//(Lemire, Kaser & Kurz, "Faster Remainder by Direct Computation"), which the
+//ladder stores next to every prime
+template <prime_growth Growth = prime_growth::doubling>
+struct basic_prime_reciprocal_policy {
+    size_t _bucket_count = 1;
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 _reciprocal = 0;
+#endif
+
+    static size_t bucket_count_for(size_t n) {
+        return prime_step_for(n, Growth).prime;
+    }
+
+    void reset(size_t bucket_count) {
+        _bucket_count = bucket_count;
+#if defined(__SIZEOF_INT128__)
+        //a count that isn't on the ladder (e.g. read from a file written with
+        //another one) gets its reciprocal computed: ceil(2^128 / bucket_count)
+        const prime_step & step = prime_step_for(bucket_count, Growth);
+        if(step.prime == bucket_count) {
+            _reciprocal = static_cast<unsigned __int128>(step.reciprocal_high) << 64 | step.reciprocal_low;
+        } else {
+            _reciprocal = ~static_cast<unsigned __int128>(0) / bucket_count + 1;
+        }
+#endif
+    }
+
+    size_t index(size_t code) const {
+#if defined(__SIZEOF_INT128__)
+        //the fractional part of code / bucket_count, scaled back up by bucket_count
+        unsigned __int128 fraction = _reciprocal * static_cast<uint64_t>(code);
+        unsigned __int128 low = static_cast<uint64_t>(fraction) * static_cast<unsigned __int128>(_bucket_count);
+        unsigned __int128 high = (fraction >> 64) * _bucket_count;
+        return static_cast<size_t>((high + (low >> 64)) >> 64);
+#else
+        return code % _bucket_count;
+#endif
+    }
+};
+
+//the defaults: prime bucket counts that about double on every growth
+using prime_modulo_policy = basic_prime_modulo_policy<>;
+using prime_reciprocal_policy = basic_prime_reciprocal_policy<>;
+
+//grows by about 1.5x instead: less memory per element after a growth, at
+//the price of more rehashes (and shorter stretches between them) on the way up
+using prime_one_and_a_half_policy = basic_prime_reciprocal_policy<prime_growth::one_and_a_half>;
+
+//power of two bucket counts, the index is the top bits of a Fibonacci
+//(golden ratio) multiply so every bit of the hash code takes part
+struct power_of_two_policy {
+    unsigned _shift = 63;
+
+    static size_t bucket_count_for(size_t n) {
+        //at least two buckets so the shift below stays under 64
+        return std::bit_ceil(n < 2 ? size_t(2) : n);
+    }
+
+    void reset(size_t bucket_count) {
+        _shift = 64 - std::countr_zero(bucket_count);
+    }
+
+    size_t index(size_t code) const {
+        return static_cast<size_t>((static_cast<uint64_t>(code) * 0x9E3779B97F4A7C15ull) >> _shift);
+    }
+};
+
+//Lemire's fastrange: (code * bucket_count) >> 64, one multiplication and any
+//bucket count, but only the high bits of the hash code pick the bucket, so it
+//needs a hash whose high bits are well mixed (not e.g. std::hash for integers)
+struct fastrange_policy {
+    size_t _bucket_count = 1;
+
+    static size_t bucket_count_for(size_t n) {
+        return next_greater_prime(n);
+    }
+
+    void reset(size_t bucket_count) {
+        _bucket_count = bucket_count;
+    }
+
+    size_t index(size_t code) const {
+#if defined(__SIZEOF_INT128__)
+        return static_cast<size_t>((static_cast<unsigned __int128>(code) * _bucket_count) >> 64);
+#else
+        return code % _bucket_count;
+#endif
+    }
+};
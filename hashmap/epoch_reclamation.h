@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm> // std::min
+#include <atomic>
+#include <cstdint>   // uint64_t
+#include <limits>    // std::numeric_limits
+#include <vector>
+
+/*
+    Epoch based reclamation, for structures whose readers take no locks.
+
+    A reader wraps every access in an epoch_guard, which announces the global
+    epoch it started in. A writer that unlinks a node cannot free it at once,
+    since a reader may still be standing on it; it hands the node to a
+    retired_list instead, tagged with the epoch at the moment of unlinking,
+    and advances the epoch. A node tagged r is freed once every reader that
+    is still inside a guard announced an epoch later than r, because those
+    readers started after the unlink and can no longer reach the node.
+
+    Readers are tracked in one process wide list of per-thread records, each
+    on its own cache line, so entering a guard writes only the thread's own
+    line and reads the global epoch, which only changes when a writer
+    retires something. Records are claimed on a thread's first guard and
+    handed back for reuse when the thread exits; they are never freed.
+
+    Guards nest, only the outermost one announces. A reader must not wait
+    for a writer while inside a guard, or the writer's memory is never freed.
+*/
+class epoch_domain {
+    //0 marks a thread that is not inside a guard, so epochs start at 1
+    struct alignas(64) Participant {
+        std::atomic<uint64_t> epoch = 0;
+        std::atomic<bool> claimed = true;
+        Participant * next = nullptr;
+        //guard nesting depth, only touched by the owning thread
+        unsigned depth = 0;
+    };
+
+    struct Registration {
+        Participant * participant;
+
+        Registration() {
+            //reuse the record of a thread that has exited, or push a new one
+            for(Participant * p = _participants().load(std::memory_order_acquire); p; p = p->next) {
+                bool claimed = false;
+                if(!p->claimed.load(std::memory_order_relaxed)
+                   && p->claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire)) {
+                    participant = p;
+                    return;
+                }
+            }
+            participant = new Participant;
+            Participant * head = _participants().load(std::memory_order_relaxed);
+            do {
+                participant->next = head;
+            } while(!_participants().compare_exchange_weak(head, participant, std::memory_order_release,
+                                                           std::memory_order_relaxed));
+        }
+
+        ~Registration() {
+            participant->epoch.store(0, std::memory_order_release);
+            participant->claimed.store(false, std::memory_order_release);
+        }
+    };
+
+    static std::atomic<uint64_t> & _epoch() {
+        static std::atomic<uint64_t> epoch = 1;
+        return epoch;
+    }
+
+    static std::atomic<Participant *> & _participants() {
+        static std::atomic<Participant *> participants = nullptr;
+        return participants;
+    }
+
+    static Participant & _local() {
+        thread_local Registration registration;
+        return *registration.participant;
+    }
+
+    friend class epoch_guard;
+
+    public:
+
+    static uint64_t retire_epoch() {
+        //called after a node is unlinked, returns its tag and starts a new
+        //epoch; readers that see the new epoch also see the unlink
+        return _epoch().fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    static uint64_t oldest_active() {
+        //the earliest epoch announced by a reader still inside a guard, or
+        //the largest uint64_t if there is none; anything tagged below it is
+        //unreachable
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for(Participant * p = _participants().load(std::memory_order_acquire); p; p = p->next) {
+            uint64_t epoch = p->epoch.load(std::memory_order_acquire);
+            if(epoch != 0) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+        return oldest;
+    }
+};
+
+class epoch_guard {
+    epoch_domain::Participant & _participant;
+
+    public:
+
+    epoch_guard() : _participant(epoch_domain::_local()) {
+        if(_participant.depth++ == 0) {
+            _participant.epoch.store(epoch_domain::_epoch().load(std::memory_order_acquire),
+                                     std::memory_order_relaxed);
+            //the announcement must be visible before the first pointer is
+            //read, or a writer scanning the records could miss this reader
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    ~epoch_guard() {
+        if(--_participant.depth == 0) {
+            _participant.epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    epoch_guard(const epoch_guard &) = delete;
+    epoch_guard & operator=(const epoch_guard &) = delete;
+};
+
+/*
+    Memory waiting for the readers of its epoch to finish. Not thread safe,
+    it belongs to whatever serializes the writers.
+*/
+class retired_list {
+    struct Retired {
+        uint64_t epoch;
+        void * pointer;
+        void (*destroy)(void *);
+    };
+
+    std::vector<Retired> _retired;
+
+    public:
+
+    retired_list() = default;
+    retired_list(const retired_list &) = delete;
+    retired_list & operator=(const retired_list &) = delete;
+
+    ~retired_list() {
+        //the owner is being destroyed, so no reader can be left
+        for(Retired & retired : _retired)
+            retired.destroy(retired.pointer);
+    }
+
+    template <typename U>
+    void retire(U * pointer) {
+        //pointer must already be unreachable for new readers
+        _retired.push_back({ epoch_domain::retire_epoch(), pointer,
+                             [](void * p) { delete static_cast<U *>(p); } });
+    }
+
+    void reclaim() {
+        //frees everything no reader can still see
+        if(_retired.empty()) {
+            return;
+        }
+        uint64_t oldest = epoch_domain::oldest_active();
+        auto kept = _retired.begin();
+        for(Retired & retired : _retired) {
+            if(retired.epoch < oldest) {
+                retired.destroy(retired.pointer);
+            } else {
+                *kept++ = retired;
+            }
+        }
+        _retired.erase(kept, _retired.end());
+    }
+
+    size_t size() const noexcept {
+        return _retired.size();
+    }
+};
@@ -1,28 +1,464 @@
 #include "hash_functions.h"
 
-size_t polynomial_rolling_hash::operator() (std::string const & str) const {
-    size_t hash = 0;
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__) && defined(__AVX512BW__) && defined(__AVX512VL__)
+#include <immintrin.h>
+#define HASH_BATCH_AVX512 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define HASH_BATCH_AVX2 1
+#endif
+
+static constexpr size_t polynomial_base = polynomial_rolling_hash::base;
+static constexpr size_t polynomial_modulus = polynomial_rolling_hash::modulus;
+static constexpr size_t fnv1a_basis = fnv1a_hash::basis;
+static constexpr size_t fnv1a_prime = fnv1a_hash::prime;
+
+//unaligned little endian loads
+static uint64_t read64(const char * p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t read32(const char * p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+#if defined(HASH_BATCH_AVX512) || defined(HASH_BATCH_AVX2)
+
+#if defined(HASH_BATCH_AVX512)
+//8 lanes of 64 bits
+//(the shifts use the zero masked forms with every lane enabled, the plain ones
+//trip -Wmaybe-uninitialized in GCC 12's headers)
+struct simd_lanes {
+    using vec = __m512i;
+    using mask = __mmask8;
+    static constexpr size_t width = 8;
+
+    static vec load(const uint64_t * p) { return _mm512_loadu_si512(p); }
+    static void store(uint64_t * p, vec v) { _mm512_storeu_si512(p, v); }
+    static vec set1(uint64_t x) { return _mm512_set1_epi64(static_cast<long long>(x)); }
+    static vec add(vec a, vec b) { return _mm512_add_epi64(a, b); }
+    static vec bit_xor(vec a, vec b) { return _mm512_xor_si512(a, b); }
+    //a * b mod 2^64
+    static vec multiply(vec a, vec b) { return _mm512_mullo_epi64(a, b); }
+    //byte j of every lane, sign extended to 64 bits
+    static vec signed_byte(vec word, unsigned j) {
+        return _mm512_maskz_srai_epi64(0xFF, _mm512_maskz_sllv_epi64(0xFF, word, set1(56 - 8 * j)), 56);
+    }
+    //lanes whose key is longer than position
+    static mask active(vec lengths, uint64_t position) { return _mm512_cmpgt_epu64_mask(lengths, set1(position)); }
+    static vec select(mask m, vec on, vec off) { return _mm512_mask_blend_epi64(m, off, on); }
+};
+#else
+//4 lanes of 64 bits
+struct simd_lanes {
+    using vec = __m256i;
+    static constexpr size_t width = 4;
+
+    static vec load(const uint64_t * p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static void store(uint64_t * p, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    static vec set1(uint64_t x) { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+    static vec add(vec a, vec b) { return _mm256_add_epi64(a, b); }
+    static vec bit_xor(vec a, vec b) { return _mm256_xor_si256(a, b); }
+    //a * b mod 2^64 out of three 32 bit multiplies, there is no 64 bit one
+    static vec multiply(vec a, vec b) {
+        vec low = _mm256_mul_epu32(a, b);
+        vec cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+        return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+    }
+    //there is no 64 bit arithmetic shift either, so the byte is sign extended
+    //with (b ^ 0x80) - 0x80
+    static vec signed_byte(vec word, unsigned j) {
+        vec byte = _mm256_and_si256(_mm256_srl_epi64(word, _mm_cvtsi32_si128(8 * j)), set1(0xFF));
+        return _mm256_sub_epi64(_mm256_xor_si256(byte, set1(0x80)), set1(0x80));
+    }
+};
+#endif
+
+using vec = simd_lanes::vec;
+
+//each kernel call hashes several vectors' worth of keys, so the multiplies of
+//one vector fill the latency of the others'
+static constexpr size_t batch_vectors = 4;
+static constexpr size_t batch_keys = batch_vectors * simd_lanes::width;
+
+static uint64_t read_block(std::string_view key, size_t offset) {
+    //the 8 bytes of key starting at offset, zero padded past its end,
+    //without reading a byte outside the key
+#if defined(HASH_BATCH_AVX512)
+    //a masked load never touches the bytes masked off, and has no branches
+    //to mispredict when the keys have mixed lengths
+    size_t start = std::min(offset, key.size());
+    size_t left = std::min<size_t>(key.size() - start, 8);
+    __mmask16 bytes = static_cast<__mmask16>((1u << left) - 1);
+    return _mm_cvtsi128_si64(_mm_maskz_loadu_epi8(bytes, key.data() + start));
+#else
+    if(offset >= key.size()) {
+        return 0;
+    }
+    const char * p = key.data() + offset;
+    size_t left = key.size() - offset;
+    if(left >= 8) {
+        return read64(p);
+    }
+    if(key.size() >= 8) {
+        //the last 8 bytes of the key, shifted down to drop what came before offset
+        return read64(key.data() + key.size() - 8) >> (8 * (8 - left));
+    }
+    if(left >= 4) {
+        //two overlapping 4 byte reads
+        return read32(p) | (read32(p + left - 4) << (8 * (left - 4)));
+    }
+    uint64_t v = 0;
+    for(size_t i = 0; i < left; i++)
+        v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    return v;
+#endif
+}
+
+static size_t load_lengths(const std::string_view * keys, uint64_t * lengths) {
+    //fills lengths for batch_keys keys and returns the longest
+    size_t longest = 0;
+    for(size_t i = 0; i < batch_keys; i++) {
+        lengths[i] = keys[i].size();
+        longest = std::max(longest, keys[i].size());
+    }
+    return longest;
+}
+
+//the kernels walk all keys in steps of 8 bytes: every lane gets the next 8
+//bytes of its key, which are then taken apart one byte at a time with each byte
+//sign extended exactly as the scalar loops do with str[i] (char is signed)
+
+#if defined(HASH_BATCH_AVX512)
+//only with a 64 bit vector multiply, the three 32 bit ones AVX2 needs for it
+//(on 4 lanes) lose to the scalar loop's single imul
+
+//the lanes run for as many bytes as the group's longest key, the scalar loop
+//only for each key's own; with 1 to n byte keys benchmarks/batch_hash measured
+//2.0x at n = 8, 1.09x at 24, 0.85x at 32 and 0.66x at 64, so groups with a key
+//longer than this are hashed one key at a time
+static constexpr size_t fnv1a_lanes_longest = 24;
+
+static void fnv1a_lanes(const std::string_view * keys, size_t * out) {
+    using L = simd_lanes;
+    uint64_t lengths[batch_keys];
+    uint64_t words[batch_keys];
+    size_t longest = load_lengths(keys, lengths);
+
+    vec prime = L::set1(fnv1a_prime);
+    vec length[batch_vectors], hash[batch_vectors];
+    for(size_t v = 0; v < batch_vectors; v++) {
+        length[v] = L::load(lengths + v * L::width);
+        hash[v] = L::set1(fnv1a_basis);
+    }
+
+    for(size_t offset = 0; offset < longest; offset += 8) {
+        for(size_t i = 0; i < batch_keys; i++)
+            words[i] = read_block(keys[i], offset);
+        vec word[batch_vectors];
+        for(size_t v = 0; v < batch_vectors; v++)
+            word[v] = L::load(words + v * L::width);
+
+        size_t bytes = std::min<size_t>(8, longest - offset);
+        for(unsigned j = 0; j < bytes; j++) {
+#pragma GCC unroll 4
+            for(size_t v = 0; v < batch_vectors; v++) {
+                //lanes whose key has already ended keep their hash
+                vec next = L::multiply(L::bit_xor(hash[v], L::signed_byte(word[v], j)), prime);
+                hash[v] = L::select(L::active(length[v], offset + j), next, hash[v]);
+            }
+        }
+    }
+
+    for(size_t v = 0; v < batch_vectors; v++)
+        L::store(reinterpret_cast<uint64_t *>(out) + v * L::width, hash[v]);
+}
+#endif
+
+static void polynomial_lanes(const std::string_view * keys, size_t * out) {
+    using L = simd_lanes;
+    uint64_t lengths[batch_keys];
+    uint64_t words[batch_keys];
+    size_t longest = load_lengths(keys, lengths);
+
+    vec hash[batch_vectors];
+    for(size_t v = 0; v < batch_vectors; v++)
+        hash[v] = L::set1(0);
+
+    //the powers of the base only depend on the position, so they are shared by
+    //every lane, and the zero padding past the end of a key adds nothing
     size_t p = 1;
-    size_t b = 19;
-    size_t m = 3298534883309ul;
+    for(size_t offset = 0; offset < longest; offset += 8) {
+        for(size_t i = 0; i < batch_keys; i++)
+            words[i] = read_block(keys[i], offset);
+        vec word[batch_vectors];
+        for(size_t v = 0; v < batch_vectors; v++)
+            word[v] = L::load(words + v * L::width);
 
-    for(size_t i = 0; i < str.size(); i++) {
-        hash += str[i] * p;
-        p = (p * b) % m;
+        size_t bytes = std::min<size_t>(8, longest - offset);
+        for(unsigned j = 0; j < bytes; j++) {
+            vec power = L::set1(p);
+#pragma GCC unroll 4
+            for(size_t v = 0; v < batch_vectors; v++)
+                hash[v] = L::add(hash[v], L::multiply(L::signed_byte(word[v], j), power));
+            p = (p * polynomial_base) % polynomial_modulus;
+        }
     }
-    return hash;
 
+    for(size_t v = 0; v < batch_vectors; v++)
+        L::store(reinterpret_cast<uint64_t *>(out) + v * L::width, hash[v]);
 }
 
-size_t fnv1a_hash::operator() (std::string const & str) const {
-    size_t basis = 0xCBF29CE484222325;
-    size_t prime = 0x00000100000001B3;
-    size_t hash = basis;
+#endif
+
+void polynomial_rolling_hash::hash_batch(const std::string_view * keys, size_t count, size_t * out) const {
+    size_t i = 0;
+#if defined(HASH_BATCH_AVX512) || defined(HASH_BATCH_AVX2)
+    for(; i + batch_keys <= count; i += batch_keys)
+        polynomial_lanes(keys + i, out + i);
+#endif
+    for(; i < count; i++)
+        out[i] = (*this)(keys[i]);
+}
 
-    for(size_t i = 0; i < str.size(); i++) {
-        hash = hash ^ str[i];
-        hash = hash * prime;
+void fnv1a_hash::hash_batch(const std::string_view * keys, size_t count, size_t * out) const {
+    size_t i = 0;
+#if defined(HASH_BATCH_AVX512)
+    for(; i + batch_keys <= count; i += batch_keys) {
+        bool short_keys = std::all_of(keys + i, keys + i + batch_keys,
+                                      [](std::string_view key) { return key.size() <= fnv1a_lanes_longest; });
+        if(short_keys) {
+            fnv1a_lanes(keys + i, out + i);
+        } else {
+            for(size_t k = i; k < i + batch_keys; k++)
+                out[k] = (*this)(keys[k]);
+        }
     }
-    return hash;
+#endif
+    for(; i < count; i++)
+        out[i] = (*this)(keys[i]);
+}
 
+static void multiply128(uint64_t & a, uint64_t & b) {
+    //replaces a and b with the low and high halves of a * b
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static uint64_t mix(uint64_t a, uint64_t b) {
+    multiply128(a, b);
+    return a ^ b;
+}
+
+static uint64_t wyhash_seeded(std::string_view str, uint64_t seed) {
+    static constexpr uint64_t secret[4] = {
+        0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+    };
+
+    const char * p = str.data();
+    size_t len = str.size();
+    seed ^= mix(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+
+    if(len <= 16) {
+        //short keys are read as (possibly overlapping) 4 byte words
+        if(len >= 4) {
+            size_t offset = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + offset);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - offset);
+        } else if(len > 0) {
+            a = (static_cast<uint64_t>(static_cast<uint8_t>(p[0])) << 16)
+                | (static_cast<uint64_t>(static_cast<uint8_t>(p[len >> 1])) << 8)
+                | static_cast<uint8_t>(p[len - 1]);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if(i > 48) {
+            //three independent lanes of 16 bytes per round
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+                see1 = mix(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+                see2 = mix(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        //the last 16 bytes, overlapping what was already mixed in
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    multiply128(a, b);
+    return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+size_t wyhash::operator() (std::string_view str) const {
+    return wyhash_seeded(str, 0);
+}
+
+static uint64_t random_seed() {
+    //64 bits from the operating system's random source
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) | device();
+}
+
+seeded_wyhash::seeded_wyhash() : _seed(random_seed()) {}
+
+size_t seeded_wyhash::operator() (std::string_view str) const {
+    return wyhash_seeded(str, _seed);
+}
+
+void seeded_wyhash::reseed() {
+    _seed = random_seed();
+}
+
+static uint64_t rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static void sip_round(uint64_t & v0, uint64_t & v1, uint64_t & v2, uint64_t & v3) {
+    v0 += v1; v1 = rotate_left(v1, 13); v1 ^= v0; v0 = rotate_left(v0, 32);
+    v2 += v3; v3 = rotate_left(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotate_left(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotate_left(v1, 17); v1 ^= v2; v2 = rotate_left(v2, 32);
+}
+
+siphash13::siphash13() : _k0(random_seed()), _k1(random_seed()) {}
+
+size_t siphash13::operator() (std::string_view str) const {
+    const char * p = str.data();
+    size_t len = str.size();
+
+    uint64_t v0 = _k0 ^ 0x736f6d6570736575ull;
+    uint64_t v1 = _k1 ^ 0x646f72616e646f6dull;
+    uint64_t v2 = _k0 ^ 0x6c7967656e657261ull;
+    uint64_t v3 = _k1 ^ 0x7465646279746573ull;
+
+    //one round per 8 byte word
+    for(; len >= 8; p += 8, len -= 8) {
+        uint64_t m = read64(p);
+        v3 ^= m;
+        sip_round(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    //the last word holds the remaining bytes and the length (mod 256) on top
+    uint64_t last = static_cast<uint64_t>(str.size()) << 56;
+    if(len > 0) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, len);
+        last |= tail;
+    }
+    v3 ^= last;
+    sip_round(v0, v1, v2, v3);
+    v0 ^= last;
+
+    //three finalization rounds
+    v2 ^= 0xFF;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void siphash13::reseed() {
+    _k0 = random_seed();
+    _k1 = random_seed();
+}
+
+#if !defined(__SSE4_2__)
+//CRC32C (Castagnoli, reflected polynomial 0x82F63B78) one byte at a time
+static constexpr std::array<uint32_t, 256> crc32c_table = [] {
+    std::array<uint32_t, 256> table {};
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+        table[i] = crc;
+    }
+    return table;
+}();
+#endif
+
+static uint64_t crc32c_step(uint64_t crc, uint64_t word) {
+    //folds 8 bytes into crc, same result as the SSE4.2 instruction
+#if defined(__SSE4_2__)
+    return _mm_crc32_u64(crc, word);
+#else
+    uint32_t c = static_cast<uint32_t>(crc);
+    for(int i = 0; i < 8; i++, word >>= 8)
+        c = crc32c_table[(c ^ word) & 0xFF] ^ (c >> 8);
+    return c;
+#endif
+}
+
+size_t crc32c_hash::operator() (std::string_view str) const {
+    const char * p = str.data();
+    size_t len = str.size();
+
+    //two lanes keep two crc32 instructions in flight and give us 64 bits of state
+    uint64_t lo = 0xFFFFFFFF;
+    uint64_t hi = 0x2D358DCC;
+    for(; len >= 16; p += 16, len -= 16) {
+        lo = crc32c_step(lo, read64(p));
+        hi = crc32c_step(hi, read64(p + 8));
+    }
+    if(len >= 8) {
+        lo = crc32c_step(lo, read64(p));
+        p += 8;
+        len -= 8;
+    }
+    if(len > 0) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, len);
+        hi = crc32c_step(hi, tail);
+    }
+
+    //a crc is linear in its input, so finish with a multiplicative mix (and
+    //the length, which tells apart keys that only differ by trailing zeros)
+    uint64_t hash = ((hi << 32) | lo) ^ str.size();
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
 }
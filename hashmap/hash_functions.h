@@ -1,11 +1,133 @@
 #pragma once
 
+#include <concepts>
+#include <cstdint>
 #include <string>
+#include <string_view>
+
+//the string hashes take a std::string_view so they work for std::string,
+//std::string_view and const char * alike, and declare is_transparent so an
+//UnorderedMap<std::string, T, H, std::equal_to<>> can be searched with any
+//of them without building a std::string first
+
+//polynomial_rolling_hash and fnv1a_hash also hash many keys at once with
+//hash_batch: out[i] = (*this)(keys[i]) for i < count, bit for bit, but computed
+//for 32 keys side by side in SIMD lanes with AVX-512 (F, DQ, BW and VL), or 16
+//with AVX2 for polynomial_rolling_hash only, when the target supports it
+//(-mavx2 / -march=native), one key at a time otherwise, UnorderedMap's
+//find_batch and insert_batch use it when present
+//fnv1a's lanes only pay off for short keys: a group of 32 with a key longer
+//than 24 bytes is hashed one key at a time (1 to 24 byte keys measured about
+//1.1x to 2x faster in lanes, 1 to 40 byte keys 0.76x, so the crossover is
+//around 24 bytes)
+
+//the two are constexpr too, so a literal can be hashed at compile time, e.g.
+//    switch(fnv1a_hash{}(command)) { case fnv1a_hash{}("get"): ... }
+//(FrozenMap.h builds whole tables that way)
 
 struct polynomial_rolling_hash {
-    size_t operator() (std::string const & str) const;
+    using is_transparent = void;
+
+    static constexpr size_t base = 19;
+    static constexpr size_t modulus = 3298534883309ul;
+
+    constexpr size_t operator() (std::string_view str) const {
+        size_t hash = 0;
+        size_t p = 1;
+
+        for(size_t i = 0; i < str.size(); i++) {
+            hash += str[i] * p;
+            p = (p * base) % modulus;
+        }
+        return hash;
+    }
+    void hash_batch(const std::string_view * keys, size_t count, size_t * out) const;
 };
 
 struct fnv1a_hash {
-    size_t operator() (std::string const & str) const;
+    using is_transparent = void;
+
+    static constexpr size_t basis = 0xCBF29CE484222325;
+    static constexpr size_t prime = 0x00000100000001B3;
+
+    constexpr size_t operator() (std::string_view str) const {
+        size_t hash = basis;
+
+        for(size_t i = 0; i < str.size(); i++) {
+            hash = hash ^ str[i];
+            hash = hash * prime;
+        }
+        return hash;
+    }
+    void hash_batch(const std::string_view * keys, size_t count, size_t * out) const;
+};
+
+//wyhash (final version 4), reads 8 bytes at a time and mixes them with
+//64x64->128 bit multiplies, 48 bytes per round for long keys
+struct wyhash {
+    using is_transparent = void;
+
+    size_t operator() (std::string_view str) const;
+};
+
+//the hashes above are fixed functions of the key, so whoever picks the keys
+//can also pick ones that all collide and make every lookup walk one chain
+//siphash13 (SipHash-1-3, keyed with 128 bits) and seeded_wyhash (wyhash with a
+//64 bit seed) draw their seed from std::random_device for every instance
+//reseed() draws a new one, which UnorderedMap does on its own (rehashing every
+//key) when an insert finds a bucket chain far longer than the load factor allows
+//SipHash is the one to use against a determined attacker, seeded wyhash is
+//several times faster but has no such security claim
+struct siphash13 {
+    using is_transparent = void;
+
+    siphash13();
+    siphash13(uint64_t k0, uint64_t k1) : _k0(k0), _k1(k1) {}
+
+    size_t operator() (std::string_view str) const;
+    void reseed();
+
+    private:
+
+    uint64_t _k0, _k1;
+};
+
+struct seeded_wyhash {
+    using is_transparent = void;
+
+    seeded_wyhash();
+    explicit seeded_wyhash(uint64_t seed) : _seed(seed) {}
+
+    size_t operator() (std::string_view str) const;
+    void reseed();
+
+    private:
+
+    uint64_t _seed;
+};
+
+//CRC32C with the SSE4.2 crc32 instruction over two interleaved 8 byte lanes
+//whose results are mixed into 64 bits, table driven (and much slower) when the
+//target has no SSE4.2 (-msse4.2 / -march=native turn it on)
+struct crc32c_hash {
+    using is_transparent = void;
+
+    size_t operator() (std::string_view str) const;
+};
+
+//for integer keys: std::hash<integer> is the identity, which is fine for prime
+//modulo buckets but leaves the high bits empty for power_of_two_policy and
+//fastrange_policy, this finalizer (from SplitMix64) spreads every input bit
+//over the whole result
+struct integer_hash {
+    template <std::integral I>
+    constexpr size_t operator() (I key) const noexcept {
+        uint64_t x = static_cast<uint64_t>(key);
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
 };
@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <fstream>
 #include <array>
+#include <chrono>
 
 constexpr size_t MAX_TERMINAL_WIDTH = 80;
 constexpr size_t N_ELEMENTS = 1e4;
@@ -39,7 +40,11 @@ enum class HashType {
     ZERO,
     FIRST_CHARACTER,
     POLYNOMIAL_ROLLING,
-    FNV1A
+    FNV1A,
+    WYHASH,
+    CRC32C,
+    SIPHASH,
+    SEEDED_WYHASH
 };
 
 struct hash_selector {
@@ -47,6 +52,10 @@ struct hash_selector {
     first_character_hash _first_char_hash;
     polynomial_rolling_hash _poly_rolling_hash;
     fnv1a_hash _fnv1a_hash;
+    wyhash _wyhash;
+    crc32c_hash _crc32c_hash;
+    siphash13 _siphash;
+    seeded_wyhash _seeded_wyhash;
     HashType _htype;
 
     public:
@@ -65,6 +74,14 @@ struct hash_selector {
                 return _poly_rolling_hash(str);
             case HashType::FNV1A:
                 return _fnv1a_hash(str);
+            case HashType::WYHASH:
+                return _wyhash(str);
+            case HashType::CRC32C:
+                return _crc32c_hash(str);
+            case HashType::SIPHASH:
+                return _siphash(str);
+            case HashType::SEEDED_WYHASH:
+                return _seeded_wyhash(str);
         }
 
         return 0;
@@ -81,7 +98,7 @@ HashType prompt_hash_type() {
         HashType type; 
     };
 
-    std::array<HashChoice const, 4> choices = {
+    std::array<HashChoice const, 8> choices = {
         HashChoice {
             .label = "Zero Hash",
             .type = HashType::ZERO,
@@ -97,6 +114,22 @@ HashType prompt_hash_type() {
         HashChoice {
             .label = "FNV-1A",
             .type = HashType::FNV1A,
+        },
+        HashChoice {
+            .label = "wyhash",
+            .type = HashType::WYHASH,
+        },
+        HashChoice {
+            .label = "CRC32C",
+            .type = HashType::CRC32C,
+        },
+        HashChoice {
+            .label = "SipHash-1-3 (random seed)",
+            .type = HashType::SIPHASH,
+        },
+        HashChoice {
+            .label = "wyhash (random seed)",
+            .type = HashType::SEEDED_WYHASH,
         }
     };
 
@@ -161,6 +194,33 @@ class AnimalDistribution {
 };
 
 constexpr size_t N_SAMPLE_HASHES = 5;
+constexpr size_t LONG_KEY_BYTES = 4096;
+constexpr size_t THROUGHPUT_BYTES = 1ull << 28;
+
+//keeps the throughput loops from being optimized away
+static volatile size_t hash_sink;
+
+//hashes keys over and over until THROUGHPUT_BYTES have gone through the hash
+//and returns the rate in GB/s
+static double hash_throughput(hash_selector const & hash, std::vector<std::string> const & keys) {
+    size_t bytes_per_pass = 0;
+    for(std::string const & key : keys)
+        bytes_per_pass += key.size();
+
+    size_t passes = std::max<size_t>(THROUGHPUT_BYTES / std::max<size_t>(bytes_per_pass, 1), 1);
+    size_t sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t pass = 0; pass < passes; pass++)
+        for(std::string const & key : keys)
+            sum += hash(key);
+    auto stop = std::chrono::steady_clock::now();
+
+    hash_sink = sum;
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return passes * bytes_per_pass / seconds / 1e9;
+}
 
 int main() {
     fs::path data_files = fs::path("..") / "data_files";
@@ -185,28 +245,22 @@ int main() {
     }
 
     UnorderedMap<std::string, int, hash_selector> map(30, hash);
+    //keep the table at 31 buckets so the histogram below stays readable,
+    //the map would otherwise grow to keep its load factor under 1
+    map.max_load_factor(std::numeric_limits<float>::max());
 
+    std::vector<std::string> keys;
     for(size_t i = 0; i < N_ELEMENTS; i++) {
-        map.insert({distribution(generator), 0});
+        keys.push_back(distribution(generator));
+        map.insert({keys.back(), 0});
     }
 
+    hash_table_stats stats = map.stats();
+
     std::vector<size_t> bucket_sizes(map.bucket_count());
-    size_t max_count = std::numeric_limits<size_t>::min();
-    for(size_t bucket = 0; bucket < map.bucket_count(); bucket++) {
+    for(size_t bucket = 0; bucket < map.bucket_count(); bucket++)
         bucket_sizes[bucket] = map.bucket_size(bucket);
-        max_count = std::max(max_count, bucket_sizes[bucket]);
-    }
-
-    double load_variance = std::numeric_limits<double>::max();
-    if(map.size() > 1) {
-        load_variance = 0;
-        double res;
-        for(size_t i = 0; i < map.bucket_count(); i++) {
-            res = bucket_sizes[i] - map.load_factor();
-            load_variance += res * res;
-        }
-        load_variance /= map.size() - 1;
-    }
+    size_t max_count = std::max<size_t>(stats.longest_chain, 1);
 
     print_sep();
 
@@ -228,7 +282,28 @@ int main() {
     std::cout << "  Size: " << map.size() << std::endl;
     std::cout << "  Buckets: " << map.bucket_count() << std::endl;
     std::cout << "  Load factor: " << map.load_factor() << std::endl;
-    std::cout << "  Load variance: " << load_variance << std::endl;
+    std::cout << "  Load variance: " << stats.chain_length_variance << std::endl;
+    std::cout << "  Longest chain: " << stats.longest_chain << std::endl;
+    std::cout << "  Probes per hit: " << stats.average_successful_probes << std::endl;
+    std::cout << "  Probes per miss: " << stats.average_unsuccessful_probes << std::endl;
+    std::cout << "  Bytes allocated: " << stats.bytes_allocated << std::endl;
+    if(stats.counters_enabled) {
+        std::cout << "  Hash calls: " << stats.hash_calls << std::endl;
+        std::cout << "  Key comparisons: " << stats.key_comparisons << std::endl;
+        std::cout << "  Rehashes: " << stats.rehashes << " ("
+                  << std::chrono::duration<double, std::milli>(stats.rehash_time).count() << " ms)" << std::endl;
+    }
+
+    //the animal names are short, so the keys rate is mostly per call overhead,
+    //the long key shows what the hash does on bulk data
+    std::vector<std::string> long_key(1, std::string(LONG_KEY_BYTES, '\0'));
+    std::uniform_int_distribution<int> byte(0, 255);
+    for(char & c : long_key[0])
+        c = static_cast<char>(byte(generator));
+
+    std::cout << "  Throughput (keys): " << hash_throughput(hash, keys) << " GB/s" << std::endl;
+    std::cout << "  Throughput (" << LONG_KEY_BYTES << " byte key): "
+              << hash_throughput(hash, long_key) << " GB/s" << std::endl;
 
     return 0;
 }
@@ -1,311 +1,213 @@
-#include <cstddef>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "primes.h"
+
+//the ladders were generated offline: each prime is the smallest prime at
+//least twice (one and a half times) the one before it, starting from 2 and
+//capped by the largest prime size_t can hold
+//the reciprocals are ceil(2^128 / prime), high half first
 
-static const size_t _map_primes[] = {
-	2ul,
-	3ul,
-	5ul,
-	7ul,
-	11ul,
-	13ul,
-	17ul,
-	19ul,
-	23ul,
-	29ul,
-	31ul,
-	37ul,
-	41ul,
-	43ul,
-	47ul,
-	53ul,
-	59ul,
-	61ul,
-	67ul,
-	71ul,
-	73ul,
-	79ul,
-	83ul,
-	89ul,
-	97ul,
-	103ul,
-	109ul,
-	113ul,
-	127ul,
-	137ul,
-	139ul,
-	149ul,
-	157ul,
-	167ul,
-	179ul,
-	193ul,
-	199ul,
-	211ul,
-	227ul,
-	241ul,
-	257ul,
-	277ul,
-	293ul,
-	313ul,
-	337ul,
-	359ul,
-	383ul,
-	409ul,
-	439ul,
-	467ul,
-	503ul,
-	541ul,
-	577ul,
-	619ul,
-	661ul,
-	709ul,
-	761ul,
-	823ul,
-	887ul,
-	953ul,
-	1031ul,
-	1109ul,
-	1193ul,
-	1289ul,
-	1381ul,
-	1493ul,
-	1613ul,
-	1741ul,
-	1879ul,
-	2029ul,
-	2179ul,
-	2357ul,
-	2549ul,
-	2753ul,
-	2971ul,
-	3209ul,
-	3469ul,
-	3739ul,
-	4027ul,
-	4349ul,
-	4703ul,
-	5087ul,
-	5503ul,
-	5953ul,
-	6427ul,
-	6949ul,
-	7517ul,
-	8123ul,
-	8783ul,
-	9497ul,
-	10273ul,
-	11113ul,
-	12011ul,
-	12983ul,
-	14033ul,
-	15173ul,
-	16411ul,
-	17749ul,
-	19183ul,
-	20753ul,
-	22447ul,
-	24281ul,
-	26267ul,
-	28411ul,
-	30727ul,
-	33223ul,
-	35933ul,
-	38873ul,
-	42043ul,
-	45481ul,
-	49201ul,
-	53201ul,
-	57557ul,
-	62233ul,
-    #if SIZE_MAX >= UINT32_MAX
-	67307ul,
-	72817ul,
-	78779ul,
-	85229ul,
-	92203ul,
-	99733ul,
-	107897ul,
-	116731ul,
-	126271ul,
-	136607ul,
-	147793ul,
-	159871ul,
-	172933ul,
-	187091ul,
-	202409ul,
-	218971ul,
-	236897ul,
-	256279ul,
-	277261ul,
-	299951ul,
-	324503ul,
-	351061ul,
-	379787ul,
-	410857ul,
-	444487ul,
-	480881ul,
-	520241ul,
-	562841ul,
-	608903ul,
-	658753ul,
-	712697ul,
-	771049ul,
-	834181ul,
-	902483ul,
-	976369ul,
-	1056323ul,
-	1142821ul,
-	1236397ul,
-	1337629ul,
-	1447153ul,
-	1565659ul,
-	1693859ul,
-	1832561ul,
-	1982627ul,
-	2144977ul,
-	2320627ul,
-	2510653ul,
-	2716249ul,
-	2938679ul,
-	3179303ul,
-	3439651ul,
-	3721303ul,
-	4026031ul,
-	4355707ul,
-	4712381ul,
-	5098259ul,
-	5515729ul,
-	5967347ul,
-	6456007ul,
-	6984629ul,
-	7556579ul,
-	8175383ul,
-	8844859ul,
-	9569143ul,
-	10352717ul,
-	11200489ul,
-	12117689ul,
-	13109983ul,
-	14183539ul,
-	15345007ul,
-	16601593ul,
-	17961079ul,
-	19431899ul,
-	21023161ul,
-	22744717ul,
-	24607243ul,
-	26622317ul,
-	28802401ul,
-	31160981ul,
-	33712729ul,
-	80131819ul,
-	86693767ul,
-	93793069ul,
-	101473717ul,
-	109783337ul,
-	118773397ul,
-	128499677ul,
-	139022417ul,
-	150406843ul,
-	162723577ul,
-	176048909ul,
-	190465427ul,
-	206062531ul,
-	222936881ul,
-	241193053ul,
-	260944219ul,
-	282312799ul,
-	305431229ul,
-	330442829ul,
-	357502601ul,
-	386778277ul,
-	418451333ul,
-	452718089ul,
-	489790921ul,
-	529899637ul,
-	573292817ul,
-	620239453ul,
-	671030513ul,
-	725980837ul,
-	785430967ul,
-	849749479ul,
-	919334987ul,
-	994618837ul,
-	1076067617ul,
-	1164186217ul,
-	1259520799ul,
-	1362662261ul,
-	1474249943ul,
-	1594975441ul,
-	1725587117ul,
-	1866894511ul,
-	2019773507ul,
-	2185171673ul,
-	2364114217ul,
-	2557710269ul,
-	2767159799ul,
-	2993761039ul,
-	3238918481ul,
-	3504151727ul,
-	3791104843ul,
-	4101556399ul,
-	4294967291ul,
+static const prime_step _doubling_ladder[] = {
+	{ 2ul, 0x8000000000000000ull, 0x0000000000000000ull },
+	{ 5ul, 0x3333333333333333ull, 0x3333333333333334ull },
+	{ 11ul, 0x1745d1745d1745d1ull, 0x745d1745d1745d18ull },
+	{ 23ul, 0x0b21642c8590b216ull, 0x42c8590b21642c86ull },
+	{ 47ul, 0x0572620ae4c415c9ull, 0x882b9310572620afull },
+	{ 97ul, 0x02a3a0fd5c5f02a3ull, 0xa0fd5c5f02a3a0feull },
+	{ 197ul, 0x014cab88725af6e7ull, 0x4f44df833facd51eull },
+	{ 397ul, 0x00a513fd6bb00a51ull, 0x3fd6bb00a513fd6cull },
+	{ 797ul, 0x00523a758f941345ull, 0xb38da6b484561534ull },
+	{ 1597ul, 0x002909752e019a5eull, 0x93cc1007b1c5f8a1ull },
+	{ 3203ul, 0x001475f82ad6ff99ull, 0xb22729cd01ff853dull },
+	{ 6421ul, 0x000a34ddd50561e0ull, 0xfb55d69da48a442eull },
+	{ 12853ul, 0x00051950af97ca9eull, 0xfb51c2eecfa90010ull },
+	{ 25717ul, 0x00028c60e092d94eull, 0x8d0e2a4e805045ecull },
+	{ 51437ul, 0x0001462b917dd520ull, 0xe1fe6fee8f8ba896ull },
+	{ 102877ul, 0x0000a3149112ffbeull, 0x62b9a15b1a664751ull },
+	{ 205759ul, 0x00005189c6ae4fafull, 0x32c7ed2369125d82ull },
+	{ 411527ul, 0x000028c4a8e8695eull, 0x892ef0963e403a02ull },
+	{ 823117ul, 0x00001461ee34fad4ull, 0x5441816ac90c4dfbull },
+	{ 1646237ul, 0x00000a30f5e2e78cull, 0x61bcf4e58e6bcd09ull },
+	{ 3292489ul, 0x00000518796bf913ull, 0xc3e9e357b9b1da77ull },
+	{ 6584983ul, 0x0000028c3c9587b0ull, 0xfc76819044abf9b3ull },
+	{ 13169977ul, 0x000001461e38e9fcull, 0xaa5bc7f9d4f67a7eull },
+	{ 26339969ul, 0x000000a30f165f16ull, 0xdc5e83deb2bf229eull },
+	{ 52679969ul, 0x0000005187880aa0ull, 0xe00c627390264f3dull },
+	{ 105359939ul, 0x00000028c3c3fed2ull, 0xad115a8352605de7ull },
+	{ 210719881ul, 0x0000001461e1fa8bull, 0x0452fc5f9d3a7719ull },
+	{ 421439783ul, 0x0000000a30f0f4c0ull, 0x7254b0f51a2ab200ull },
+	{ 842879579ul, 0x000000051878790eull, 0xad93ff94716e739eull },
+	{ 1685759167ul, 0x000000028c3c3c4cull, 0xeaf00e998616aae4ull },
+	{ 3371518343ul, 0x00000001461e1e17ull, 0xda818cf6f0d6ba5eull },
     #if SIZE_MAX >= UINT64_MAX
-	6442450933ul,
-	8589934583ul,
-	12884901857ul,
-	17179869143ul,
-	25769803693ul,
-	34359738337ul,
-	51539607367ul,
-	68719476731ul,
-	103079215087ul,
-	137438953447ul,
-	206158430123ul,
-	274877906899ul,
-	412316860387ul,
-	549755813881ul,
-	824633720731ul,
-	1099511627689ul,
-	1649267441579ul,
-	2199023255531ul,
-	3298534883309ul,
-	4398046511093ul,
-	6597069766607ul,
-	8796093022151ul,
-	13194139533241ul,
-	17592186044399ul,
-	26388279066581ul,
-	35184372088777ul,
-	52776558133177ul,
-	70368744177643ul,
-	105553116266399ul,
-	140737488355213ul,
-	211106232532861ul,
-	281474976710597ul,
-	562949953421231ul,
-	1125899906842597ul,
-	2251799813685119ul,
-	4503599627370449ul,
-	9007199254740881ul,
-	18014398509481951ul,
-	36028797018963913ul,
-	72057594037927931ul,
-	144115188075855859ul,
-	288230376151711717ul,
-	576460752303423433ul,
-	1152921504606846883ul,
-	2305843009213693951ul,
-	4611686018427387847ul,
-	9223372036854775783ul,
-	18446744073709551557ul,
-	18446744073709551557ul
+	{ 6743036717ul, 0x00000000a30f0effull, 0x59973401354728f5ull },
+	{ 13486073473ul, 0x000000005187877bull, 0xb828d9d962e51db3ull },
+	{ 26972146961ul, 0x0000000028c3c3bdull, 0x7ab601dadccbf9baull },
+	{ 53944293929ul, 0x000000001461e1deull, 0xb1feebe7370db36eull },
+	{ 107888587883ul, 0x000000000a30f0efull, 0x4edaf57743006561ull },
+	{ 215777175787ul, 0x0000000005187877ull, 0xa54c36ca7d70c9a9ull },
+	{ 431554351609ul, 0x00000000028c3c3bull, 0xd1c2e9c0c5b56957ull },
+	{ 863108703229ul, 0x0000000001461e1dull, 0xe8cf9b087df21facull },
+	{ 1726217406467ul, 0x0000000000a30f0eull, 0xf46426c6a19b3975ull },
+	{ 3452434812973ul, 0x0000000000518787ull, 0x7a2e1ec090fd91a0ull },
+	{ 6904869625999ul, 0x000000000028c3c3ull, 0xbd15b756f05aac90ull },
+	{ 13809739252051ul, 0x00000000001461e1ull, 0xde8a85a922245379ull },
+	{ 27619478504183ul, 0x00000000000a30f0ull, 0xef4521f7e689e4caull },
+	{ 55238957008387ul, 0x0000000000051878ull, 0x77a28edaaf53d183ull },
+	{ 110477914016779ul, 0x0000000000028c3cull, 0x3bd1474ce2db8e6bull },
+	{ 220955828033581ul, 0x000000000001461eull, 0x1de8a3811e4d45b9ull },
+	{ 441911656067171ul, 0x000000000000a30full, 0x0ef451bce8690580ull },
+	{ 883823312134381ul, 0x0000000000005187ull, 0x877a28da7f91c2f1ull },
+	{ 1767646624268779ul, 0x00000000000028c3ull, 0xc3bd146cd16ef0acull },
+	{ 3535293248537579ul, 0x0000000000001461ull, 0xe1de8a3646a33944ull },
+	{ 7070586497075177ul, 0x0000000000000a30ull, 0xf0ef451b1b9c453aull },
+	{ 14141172994150357ul, 0x0000000000000518ull, 0x7877a28d8d803d7bull },
+	{ 28282345988300791ul, 0x000000000000028cull, 0x3c3bd146c4cc4b21ull },
+	{ 56564691976601587ul, 0x0000000000000146ull, 0x1e1de8a3625e085dull },
+	{ 113129383953203213ul, 0x00000000000000a3ull, 0x0f0ef451b11f31a4ull },
+	{ 226258767906406483ul, 0x0000000000000051ull, 0x87877a28d889d0d1ull },
+	{ 452517535812813007ul, 0x0000000000000028ull, 0xc3c3bd146c43de44ull },
+	{ 905035071625626043ul, 0x0000000000000014ull, 0x61e1de8a3621c013ull },
+	{ 1810070143251252131ul, 0x000000000000000aull, 0x30f0ef451b10cdc8ull },
+	{ 3620140286502504283ul, 0x0000000000000005ull, 0x187877a28d8864c3ull },
+	{ 7240280573005008577ul, 0x0000000000000002ull, 0x8c3c3bd146c4321aull },
+	{ 14480561146010017169ul, 0x0000000000000001ull, 0x461e1de8a36218f5ull },
+	{ 18446744073709551557ul, 0x0000000000000001ull, 0x000000000000003cull },
+    #else
+	{ 4294967291ul, 0x0000000100000005ull, 0x000000190000007eull },
     #endif
+};
+
+static const prime_step _one_and_a_half_ladder[] = {
+	{ 2ul, 0x8000000000000000ull, 0x0000000000000000ull },
+	{ 3ul, 0x5555555555555555ull, 0x5555555555555556ull },
+	{ 5ul, 0x3333333333333333ull, 0x3333333333333334ull },
+	{ 11ul, 0x1745d1745d1745d1ull, 0x745d1745d1745d18ull },
+	{ 17ul, 0x0f0f0f0f0f0f0f0full, 0x0f0f0f0f0f0f0f10ull },
+	{ 29ul, 0x08d3dcb08d3dcb08ull, 0xd3dcb08d3dcb08d4ull },
+	{ 47ul, 0x0572620ae4c415c9ull, 0x882b9310572620afull },
+	{ 71ul, 0x039b0ad12073615aull, 0x240e6c2b4481cd86ull },
+	{ 107ul, 0x02647c69456217ecull, 0xdc1cb5d4ef409920ull },
+	{ 163ul, 0x01920fb49d0e228dull, 0x59857f36f825b179ull },
+	{ 251ul, 0x0105197f7d734041ull, 0x465fdf5cd0105198ull },
+	{ 379ul, 0x00aceb0f891e6551ull, 0xbb1a57cf5de3a170ull },
+	{ 569ul, 0x00732d70ed8db8e9ull, 0xf44d6287df9b383eull },
+	{ 857ul, 0x004c78ae734df709ull, 0xdb8e7cdd0cd8454eull },
+	{ 1289ul, 0x0032d7aef8412458ull, 0x2e137690fb08efeaull },
+	{ 1949ul, 0x0021a01d6c19be96ull, 0x86c3b5eb3f2dd749ull },
+	{ 2927ul, 0x001663e190395ff2ull, 0x019305dc2408bf05ull },
+	{ 4391ul, 0x000eecd1a690efbbull, 0xe783780aba36afb9ull },
+	{ 6599ul, 0x0009ee633c0391abull, 0xa9914859b0f03601ull },
+	{ 9901ul, 0x00069e7f435ad500ull, 0x634974f2527b05d2ull },
+	{ 14867ul, 0x0004687cab05c4bbull, 0x23cc8c70e3d8abc8ull },
+	{ 22303ul, 0x0002f03d8608264aull, 0xa1ba9a32fc8b87aaull },
+	{ 33457ul, 0x0001f574c1864b1full, 0x9fc5f85d1ad58e78ull },
+	{ 50207ul, 0x00014e293057b36full, 0x600467cb0327fd98ull },
+	{ 75323ul, 0x0000debca9609f1dull, 0x057ee5a9db4d0650ull },
+	{ 112997ul, 0x0000947991ba0db2ull, 0x8f1fa80f7f102da4ull },
+	{ 169501ul, 0x000062fae3fe8517ull, 0x8f35aa81cfc68f48ull },
+	{ 254257ul, 0x000041fc3a7330b6ull, 0x71325b9d1f6eda0cull },
+	{ 381389ul, 0x00002bfd61d7e16bull, 0x31e2f40282a9c16eull },
+	{ 572087ul, 0x00001d538acdc869ull, 0x2a7e5a431761aa6cull },
+	{ 858149ul, 0x0000138ceb949de6ull, 0xbc00857e3892c62cull },
+	{ 1287233ul, 0x00000d0896bfef5dull, 0x4996853bae532173ull },
+	{ 1930879ul, 0x000008b05bccc2e1ull, 0xe738158f5a48fc31ull },
+	{ 2896319ul, 0x000005cae7cd1050ull, 0xc226505d46e7c449ull },
+	{ 4344479ul, 0x000003dc9a8140aeull, 0xa43e45c669ed2d31ull },
+	{ 6516739ul, 0x000002931123a0deull, 0xe7ad53ebf7acef09ull },
+	{ 9775111ul, 0x000001b760bb0df6ull, 0xe64c0d6f5ee4bab4ull },
+	{ 14662727ul, 0x00000124ead82978ull, 0x12bc33319a428905ull },
+	{ 21994111ul, 0x000000c3472ed8a6ull, 0x282bde221726552dull },
+	{ 32991187ul, 0x000000822f6f4340ull, 0x3f79e559b41a432dull },
+	{ 49486793ul, 0x00000056ca48bd08ull, 0xccae744412d47390ull },
+	{ 74230231ul, 0x00000039dc2e5f50ull, 0x89e6be9c5a9e0c1dull },
+	{ 111345347ul, 0x0000002692c991f8ull, 0x67ee0236cdefb4d1ull },
+	{ 167018021ul, 0x00000019b7310ab0ull, 0x4a9e5250a36847d8ull },
+	{ 250527047ul, 0x0000001124cb4aa9ull, 0xf68b0a94bd2b9c39ull },
+	{ 375790601ul, 0x0000000b6ddccce1ull, 0x3b35334d7be150e7ull },
+	{ 563685907ul, 0x000000079e933201ull, 0x839e15d3677af704ull },
+	{ 845528867ul, 0x00000005146220aeull, 0xa047b991358601c3ull },
+	{ 1268293309ul, 0x0000000362ec1568ull, 0x463de46784b07724ull },
+	{ 1902439967ul, 0x0000000241f2b8deull, 0x5817c4da415e8320ull },
+	{ 2853659981ul, 0x00000001814c7af9ull, 0xce5bbb0a71f608baull },
+	{ 4280489981ul, 0x0000000100dda747ull, 0xa3c29d7ea2d68c70ull },
+    #if SIZE_MAX >= UINT64_MAX
+	{ 6420734989ul, 0x00000000ab3e6f7dull, 0x433cdc5439537780ull },
+	{ 9631102487ul, 0x0000000072299fa8ull, 0x254e10d911ce75c9ull },
+	{ 14446653731ul, 0x000000004c1bbfc5ull, 0x62e3cccbc484a896ull },
+	{ 21669980653ul, 0x0000000032bd2a81ull, 0x5f12babb9fb49ce9ull },
+	{ 32504971021ul, 0x0000000021d371aaull, 0xdb3b0e4f0f4a70a3ull },
+	{ 48757456567ul, 0x00000000168cf671ull, 0xa0f7d908ae02a8b8ull },
+	{ 73136184871ul, 0x000000000f08a44bull, 0xae8bf2ae460b14d1ull },
+	{ 109704277337ul, 0x000000000a05c2ddull, 0x131038d7ae45b80bull },
+	{ 164556416029ul, 0x0000000006ae81e8ull, 0xb346ff50bdf84490ull },
+	{ 246834624053ul, 0x000000000474569bull, 0x2172d4e7baaca1dcull },
+	{ 370251936113ul, 0x0000000002f839bcull, 0xbfcfcb5c785c45abull },
+	{ 555377904197ul, 0x0000000001fad128ull, 0x7f7414262c305f7full },
+	{ 833066856311ul, 0x000000000151e0c5ull, 0xaa3262a4080c083eull },
+	{ 1249600284509ul, 0x0000000000e14083ull, 0xc6ab5a61c86eb732ull },
+	{ 1874400426809ul, 0x0000000000962b02ull, 0x846294449b4962adull },
+	{ 2811600640271ul, 0x0000000000641cacull, 0x5838ed0cf625deffull },
+	{ 4217400960467ul, 0x000000000042bdc8ull, 0x3acc815513fa4f66ull },
+	{ 6326101440707ul, 0x00000000002c7e85ull, 0x7c8823f46f481549ull },
+	{ 9489152161087ul, 0x00000000001da9aeull, 0x53051238bb82d888ull },
+	{ 14233728241643ul, 0x000000000013c674ull, 0x3758a3b840537a7full },
+	{ 21350592362537ul, 0x00000000000d2ef8ull, 0x24e591420b9ddd89ull },
+	{ 32025888543809ul, 0x000000000008c9faull, 0xc343b51dab22c9f9ull },
+	{ 48038832815767ul, 0x000000000005dbfcull, 0x822d1c3c5e76db04ull },
+	{ 72058249223771ul, 0x000000000003e7fdull, 0xac1e0ba44313d70cull },
+	{ 108087373835677ul, 0x0000000000029aa9ull, 0x1d695c8d27167752ull },
+	{ 162131060753531ul, 0x000000000001bc70ull, 0xbe463d84b7bb97b6ull },
+	{ 243196591130299ul, 0x000000000001284bull, 0x298428ffcbd4fb4aull },
+	{ 364794886695457ul, 0x000000000000c587ull, 0x7102c5facdb5ed06ull },
+	{ 547192330043299ul, 0x00000000000083afull, 0xa0ac83de80c018ffull },
+	{ 820788495064949ul, 0x00000000000057caull, 0x6b1dad3ef172763dull },
+	{ 1231182742597433ul, 0x0000000000003a86ull, 0xf213c8d421d96fa7ull },
+	{ 1846774113896183ul, 0x0000000000002704ull, 0xa16285e1fa02d9b4ull },
+	{ 2770161170844311ul, 0x0000000000001a03ull, 0x1641ae964633acc4ull },
+	{ 4155241756266527ul, 0x0000000000001157ull, 0x642bc9b93d10b265ull },
+	{ 6232862634399799ul, 0x0000000000000b8full, 0x981d31262445bb86ull },
+	{ 9349293951599717ul, 0x00000000000007b5ull, 0x101376196938e1f3ull },
+	{ 14023940927399617ul, 0x0000000000000523ull, 0x600cf96641de4865ull },
+	{ 21035911391099447ul, 0x000000000000036cull, 0xeab350eed597e9b3ull },
+	{ 31553867086649177ul, 0x0000000000000248ull, 0x9c778b49e398b60aull },
+	{ 47330800629973787ul, 0x0000000000000185ull, 0xbda5078697894efaull },
+	{ 70996200944960729ul, 0x0000000000000103ull, 0xd3c35a59ba2993f9ull },
+	{ 106494301417441121ul, 0x00000000000000adull, 0x37d7919126b9cb82ull },
+	{ 159741452126161699ul, 0x0000000000000073ull, 0x7a8fb660c4784d69ull },
+	{ 239612178189242611ul, 0x000000000000004cull, 0xfc5fceeb2d9fe1f7ull },
+	{ 359418267283863923ul, 0x0000000000000033ull, 0x52ea89f21e6a53c3ull },
+	{ 539127400925795933ul, 0x0000000000000022ull, 0x374706a1699b5a0bull },
+	{ 808691101388693933ul, 0x0000000000000016ull, 0xcf84af1646674d46ull },
+	{ 1213036652083040957ul, 0x000000000000000full, 0x35031f642eef54e8ull },
+	{ 1819554978124561553ul, 0x000000000000000aull, 0x23576a42c9f4b419ull },
+	{ 2729332467186842347ul, 0x0000000000000006ull, 0xc23a46d7314dca47ull },
+	{ 4093998700780263577ul, 0x0000000000000004ull, 0x817c2f3a20de825full },
+	{ 6140998051170395411ul, 0x0000000000000003ull, 0x00fd74d16b3efffaull },
+	{ 9211497076755593129ul, 0x0000000000000002ull, 0x00a8f88b9cd4aa75ull },
+	{ 13817245615133389729ul, 0x0000000000000001ull, 0x55c5fb07bde31c0full },
+	{ 18446744073709551557ul, 0x0000000000000001ull, 0x000000000000003cull },
+    #else
+	{ 4294967291ul, 0x0000000100000005ull, 0x000000190000007eull },
     #endif
 };
 
-static const size_t _n_map_primes = sizeof(_map_primes) / sizeof(*_map_primes);
+template <size_t N>
+static const prime_step & _step_for(const prime_step (&ladder)[N], size_t size) {
+	const prime_step *step = std::lower_bound(ladder, ladder + N, size,
+	                                          [](const prime_step & s, size_t n) { return s.prime < n; });
+	return step == ladder + N ? ladder[N - 1] : *step;
+}
+
+const prime_step & prime_step_for(size_t size, prime_growth growth) {
+	if(growth == prime_growth::one_and_a_half) {
+		return _step_for(_one_and_a_half_ladder, size);
+	}
+	return _step_for(_doubling_ladder, size);
+}
 
-size_t next_greater_prime(size_t sz) {
-	size_t const *p = std::lower_bound(_map_primes, _map_primes + _n_map_primes, sz);
-	return *p;
-}
\ No newline at end of file
+size_t next_greater_prime(size_t size) {
+	return prime_step_for(size, prime_growth::doubling).prime;
+}
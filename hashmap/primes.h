@@ -1,11 +1,34 @@
 #pragma once
 
-/*
-    Retrieves the next prime > size via a lookup table.
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
 
-    Scales with O(log(n)) where n is the size of the lookup
-    table. (E.g. it uses binary search.)
+/*
+    Prime bucket counts come from sparse ladders: sorted tables where each
+    prime is about a fixed factor above the one before it, so a table that
+    grows to the next step grows by that factor. Every prime is stored next
+    to ceil(2^128 / prime), the reciprocal prime_reciprocal_policy reduces
+    hash codes with, so switching bucket counts costs a lookup instead of a
+    128-bit division.
 
-    Practically very fast.
+    Lookups are a binary search over a few dozen entries (64 on the doubling
+    ladder, 107 on the 1.5x one).
 */
-size_t next_greater_prime(size_t size);
\ No newline at end of file
+
+struct prime_step {
+    size_t prime;
+    //ceil(2^128 / prime), split into 64-bit halves
+    uint64_t reciprocal_high;
+    uint64_t reciprocal_low;
+};
+
+enum class prime_growth {
+    doubling,       // 2, 5, 11, 23, 47, 97, ...
+    one_and_a_half, // 2, 3, 5, 11, 17, 29, 47, 71, ...
+};
+
+//the first step of the ladder whose prime is >= size (the last step if there is none)
+const prime_step & prime_step_for(size_t size, prime_growth growth = prime_growth::doubling);
+
+//the smallest prime >= size on the doubling ladder
+size_t next_greater_prime(size_t size);
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>   // std::min
+#include <array>
+#include <bit>         // std::bit_cast
+#include <cstddef>     // size_t, std::byte
+#include <cstdint>     // uint32_t, uint64_t, SIZE_MAX
+#include <cstring>     // std::memcpy, std::memcmp
+#include <istream>
+#include <ostream>
+#include <stdexcept>   // std::runtime_error
+#include <string>
+#include <type_traits> // std::is_trivially_copyable_v
+#include <vector>
+
+/*
+    The pieces UnorderedMap::serialize and deserialize are built from.
+
+    A snapshot is a snapshot_header followed by the elements in iteration
+    order, each with its cached hash code. Keys and mapped values are
+    written by snapshot_codec<Key> and snapshot_codec<T>:
+
+        trivially copyable types    their bytes
+        std::basic_string           a uint64_t length and the characters
+
+    Specialize snapshot_codec for anything else, with
+
+        template <typename Writer> static void write(Writer & out, const U & value)
+        template <typename Reader> static U read(Reader & in)
+
+    When both types are trivially copyable (and default constructible) the
+    elements are written in blocks instead: up to snapshot_block elements'
+    hash codes, then their keys, then their mapped values, each one memcpy.
+
+    Snapshots use the host's byte order and type sizes; they are meant for
+    checkpoints read back by the same build, not for exchange.
+*/
+
+struct snapshot_header {
+    static constexpr char expected_magic[8] = { 'U', 'M', 'A', 'P', 'S', 'N', 'A', 'P' };
+    static constexpr uint32_t current_version = 1;
+
+    //how the elements follow the header
+    enum layout_type : uint32_t { records = 0, blocks = 1 };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint64_t key_size;    // sizeof(Key) for the block layout, 0 for records
+    uint64_t mapped_size; // sizeof(T) likewise
+    uint64_t size;
+    uint64_t bucket_count;
+
+    static snapshot_header make(layout_type layout, uint64_t key_size, uint64_t mapped_size, uint64_t size,
+                                uint64_t bucket_count) {
+        snapshot_header header { };
+        std::memcpy(header.magic, expected_magic, sizeof(expected_magic));
+        header.version = current_version;
+        header.layout = layout;
+        header.key_size = key_size;
+        header.mapped_size = mapped_size;
+        header.size = size;
+        header.bucket_count = bucket_count;
+        return header;
+    }
+
+    void check(layout_type expected_layout, uint64_t expected_key_size, uint64_t expected_mapped_size) const {
+        //throws std::runtime_error unless this is a snapshot of the same map type
+        if(std::memcmp(magic, expected_magic, sizeof(expected_magic)) != 0) {
+            throw std::runtime_error("not an UnorderedMap snapshot");
+        }
+        if(version != current_version) {
+            throw std::runtime_error("unsupported UnorderedMap snapshot version");
+        }
+        if(layout != expected_layout || key_size != expected_key_size || mapped_size != expected_mapped_size) {
+            throw std::runtime_error("UnorderedMap snapshot was written for other key or mapped types");
+        }
+    }
+};
+
+//elements per block of the block layout
+inline constexpr size_t snapshot_block = 4096;
+
+template <typename U>
+struct snapshot_codec;
+
+template <typename U>
+    requires std::is_trivially_copyable_v<U>
+struct snapshot_codec<U> {
+    template <typename Writer>
+    static void write(Writer & out, const U & value) {
+        out.write(&value, sizeof(U));
+    }
+
+    template <typename Reader>
+    static U read(Reader & in) {
+        //bit_cast, so U needs no default constructor
+        std::array<std::byte, sizeof(U)> bytes;
+        in.read(bytes.data(), sizeof(U));
+        return std::bit_cast<U>(bytes);
+    }
+};
+
+template <typename Char, typename Traits, typename A>
+    requires std::is_trivially_copyable_v<Char>
+struct snapshot_codec<std::basic_string<Char, Traits, A>> {
+    using string_type = std::basic_string<Char, Traits, A>;
+
+    template <typename Writer>
+    static void write(Writer & out, const string_type & value) {
+        uint64_t length = value.size();
+        out.write(&length, sizeof(length));
+        out.write(value.data(), length * sizeof(Char));
+    }
+
+    template <typename Reader>
+    static string_type read(Reader & in) {
+        uint64_t length;
+        in.read(&length, sizeof(length));
+        if(length > SIZE_MAX / sizeof(Char)) {
+            throw std::runtime_error("UnorderedMap snapshot is corrupt");
+        }
+        in.check_remaining(length * sizeof(Char));
+        //read in pieces and grown as they arrive, so a corrupt length fails
+        //in read once a stream runs dry instead of allocating it all up front
+        constexpr size_t piece = (size_t(1) << 16) / sizeof(Char);
+        string_type value;
+        while(value.size() < length) {
+            size_t done = value.size();
+            size_t m = std::min<size_t>(length - done, piece);
+            value.resize(done + m);
+            in.read(value.data() + done, m * sizeof(Char));
+        }
+        return value;
+    }
+};
+
+/*
+    Writers and readers: write(data, bytes) and read(data, bytes), reads
+    throw std::runtime_error when the snapshot ends early.
+    check_remaining(bytes) lets a reader reject a corrupt length before
+    anything that large is allocated, where it knows how much is left;
+    checks_remaining says whether it does. Where it doesn't (a stream),
+    sizes and lengths must not be trusted for allocations up front.
+*/
+
+class snapshot_stream_writer {
+    //ostream::write per field is slow, so small writes are collected first
+    static constexpr size_t _capacity = 1 << 16;
+
+    std::ostream & _os;
+    std::vector<char> _buffer;
+
+    public:
+
+    explicit snapshot_stream_writer(std::ostream & os) : _os(os) {
+        _buffer.reserve(_capacity);
+    }
+
+    void write(const void * data, size_t bytes) {
+        if(_buffer.size() + bytes > _capacity) {
+            flush();
+            if(bytes >= _capacity) {
+                _os.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+                if(!_os) {
+                    throw std::runtime_error("writing the UnorderedMap snapshot failed");
+                }
+                return;
+            }
+        }
+        const char * begin = static_cast<const char *>(data);
+        _buffer.insert(_buffer.end(), begin, begin + bytes);
+    }
+
+    void flush() {
+        _os.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+        _buffer.clear();
+        if(!_os) {
+            throw std::runtime_error("writing the UnorderedMap snapshot failed");
+        }
+    }
+};
+
+class snapshot_buffer_writer {
+    std::vector<char> & _buffer;
+
+    public:
+
+    explicit snapshot_buffer_writer(std::vector<char> & buffer) : _buffer(buffer) { }
+
+    void write(const void * data, size_t bytes) {
+        const char * begin = static_cast<const char *>(data);
+        _buffer.insert(_buffer.end(), begin, begin + bytes);
+    }
+
+    void flush() { }
+};
+
+class snapshot_stream_reader {
+    std::istream & _is;
+
+    public:
+
+    static constexpr bool checks_remaining = false;
+
+    explicit snapshot_stream_reader(std::istream & is) : _is(is) { }
+
+    void read(void * data, size_t bytes) {
+        _is.read(static_cast<char *>(data), static_cast<std::streamsize>(bytes));
+        if(static_cast<size_t>(_is.gcount()) != bytes) {
+            throw std::runtime_error("UnorderedMap snapshot ends early");
+        }
+    }
+
+    void check_remaining(size_t) {
+        //a stream doesn't know, a bad length fails in read instead
+    }
+};
+
+class snapshot_buffer_reader {
+    const char * _position;
+    const char * _end;
+
+    public:
+
+    static constexpr bool checks_remaining = true;
+
+    snapshot_buffer_reader(const char * data, size_t size) : _position(data), _end(data + size) { }
+
+    void read(void * data, size_t bytes) {
+        check_remaining(bytes);
+        if(bytes) {
+            std::memcpy(data, _position, bytes);
+        }
+        _position += bytes;
+    }
+
+    void check_remaining(size_t bytes) {
+        if(bytes > static_cast<size_t>(_end - _position)) {
+            throw std::runtime_error("UnorderedMap snapshot ends early");
+        }
+    }
+};